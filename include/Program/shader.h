@@ -2,42 +2,91 @@
 #define SHADER_H
 #include <glad/glad.h>
 #include <string>
+#include <string_view>
+#include <map>
+#include <memory>
+#include <vector>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <glm/glm.hpp>
 
+/// <summary>
+/// 顶点与片段着色器源文件路径
+/// </summary>
+struct ShaderSource {
+	const char* vertexPath;
+	const char* fragmentPath;
+};
+
 /// <summary>
 /// 着色器类
 /// </summary>
 class Shader {
 public:
-	unsigned int ProgramId;
+	unsigned int ProgramId = 0;
 	/// <summary>
 	/// </summary>
 	/// <param name="vertexSource">顶点着色器源代码</param>
 	/// <param name="fragmentSource">片段着色器源代码</param>
 	Shader(const char* vertexSource, const char* fragmentSource);
+	/// <summary>
+	/// 批量创建：先提交所有程序的编译和链接，全部完成后再统一检查状态，
+	/// 驱动支持KHR_parallel_shader_compile时多个程序在驱动的后台线程并行编译
+	/// </summary>
+	/// <returns>与sources一一对应</returns>
+	static std::vector<std::unique_ptr<Shader>> createBatch(const std::vector<ShaderSource>& sources);
 	//使用
 	void use();
 
-	void setInt(std::string& name, int value);
-	void setBool(std::string& name, bool value);
-	void setFloat(std::string& name, float value);
-	void setMat4(std::string& name, glm::mat4& value);
+	/// <summary>
+	/// 查询uniform的位置，链接后已缓存所有活跃uniform，不再调用glGetUniformLocation
+	/// </summary>
+	/// <returns>不存在或已被编译器优化掉时返回-1，传给setter会被GL忽略</returns>
+	GLint uniformLocation(std::string_view name) const;
+
+	// 按缓存的位置设置，每帧调用的地方应提前取好位置
+	void setInt(GLint location, int value);
+	void setBool(GLint location, bool value);
+	void setFloat(GLint location, float value);
+	void setMat3(GLint location, const glm::mat3& value);
+	void setMat4(GLint location, const glm::mat4& value);
+	void setVec3(GLint location, const glm::vec3& value);
+
+	// 按名字设置，先查缓存
+	void setInt(std::string_view name, int value);
+	void setBool(std::string_view name, bool value);
+	void setFloat(std::string_view name, float value);
+	void setMat4(std::string_view name, const glm::mat4& value);
 
 	void setIntP(const char* name, int value);
 	void setBoolP(const char* name, bool value);
 	void setFloatP(const char* name, float value);
 	void setMat4P(const char* name, glm::mat4& value);
+	void setMat3P(const char* name, const glm::mat3& value);
+	void setVec3P(const char* name, const glm::vec3& value);
 
 	void release();
 
 private:
 
 
-	void compileAndLink(const char* vertexCode, const char* fragmentCode);
+	Shader() = default;
+
+	static bool readSources(const char* vertexSourcePath, const char* fragmentSourcePath, std::string& vertexCode, std::string& fragmentCode);
+	// 提交编译和链接，不查询状态
+	void submit(const char* vertexCode, const char* fragmentCode, unsigned int& vertex, unsigned int& fragment);
+	// 检查编译和链接状态并输出日志，会等待驱动完成
+	void finish(unsigned int vertex, unsigned int fragment);
+	// 程序二进制缓存，key由源码和驱动信息哈希得到，驱动或源码变化后自然失效
+	static std::string binaryCacheKey(const std::string& vertexCode, const std::string& fragmentCode);
+	bool loadBinary(const std::string& key);
+	void saveBinary(const std::string& key);
+	// 链接成功后枚举所有活跃uniform，缓存名字到位置的映射
+	void cacheUniforms();
 
+	// std::less<>允许直接用string_view查找，不必构造std::string
+	std::map<std::string, GLint, std::less<>> uniforms;
 
 };
 
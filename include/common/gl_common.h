@@ -6,6 +6,7 @@
 #include <GLFW/glfw3.h>
 
 
-GLFWwindow* initGlEnv(int width, int height, const char* title);
+// visible为false时创建不可见窗口，只用来持有GL上下文，配合离屏帧缓冲在无显示器的机器上渲染
+GLFWwindow* initGlEnv(int width, int height, const char* title, bool visible = true);
 #endif
 
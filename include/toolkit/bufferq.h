@@ -2,9 +2,16 @@
 #define BUFFERQ_H
 
 #include <iostream>
+#include <chrono>
 #include <condition_variable>
+#include <mutex>
+#include <optional>
 #include <queue>
 
+/// @brief 有界阻塞队列
+/// 元素以移动方式进出，支持std::unique_ptr这类只能移动的类型；
+/// close()之后push全部失败，pop会先取完剩余元素再返回std::nullopt，
+/// 所有阻塞在队列上的线程都会被唤醒，用于停止流水线。
 template <typename T>
 class OkQueue
 {
@@ -13,33 +20,77 @@ public:
                             };
     ~OkQueue() {
     };
-    void push(T msg)
+    /// @brief 入队，缓冲区满时等待
+    /// @return 队列已关闭时返回false，msg被丢弃
+    bool push(T msg)
     {
         std::unique_lock<std::mutex> lock(mtx);
         // 如果缓冲区满了则释放锁并等待
         notFull.wait(lock, [this]()
-                     { return queue.size() < size; });
-        queue.emplace(msg);
+                     { return closed_ || queue.size() < size; });
+        if (closed_)
+            return false;
+        queue.emplace(std::move(msg));
         notEmpty.notify_one();
+        return true;
     };
-    T &pop()
+    /// @brief 出队，缓冲区为空时等待
+    /// @return 队列关闭且已取空时返回std::nullopt
+    std::optional<T> pop()
     {
         std::unique_lock<std::mutex> lock(mtx);
         // 如果缓冲区为空则释放锁并等待
         notEmpty.wait(lock, [this]()
-                      { return queue.size() > 0; });
-        auto &msg= queue.front();
+                      { return closed_ || queue.size() > 0; });
+        return take();
+    };
+    /// @brief 不等待的出队，缓冲区为空时立即返回std::nullopt
+    std::optional<T> try_pop()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return take();
+    };
+    /// @brief 最多等待timeout的出队，超时或队列关闭且已取空时返回std::nullopt
+    template <typename Rep, typename Period>
+    std::optional<T> pop_for(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        notEmpty.wait_for(lock, timeout, [this]()
+                          { return closed_ || queue.size() > 0; });
+        return take();
+    };
+    /// @brief 关闭队列并唤醒所有等待的线程
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        closed_ = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    };
+    bool closed()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return closed_;
+    };
+
+private:
+    // 调用方需持有mtx
+    std::optional<T> take()
+    {
+        if (queue.empty())
+            return std::nullopt;
+        std::optional<T> msg(std::move(queue.front()));
         queue.pop();
         notFull.notify_one();
         return msg;
     };
 
-private:
     std::mutex mtx;
     std::condition_variable notFull;
     std::condition_variable notEmpty;
     std::queue<T> queue;
     int size;
+    bool closed_ = false;
 };
 
 
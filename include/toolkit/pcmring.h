@@ -0,0 +1,141 @@
+#ifndef PCMRING_H
+#define PCMRING_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <toolkit/spscq.h>
+
+/// @brief 单生产者单消费者的字节环形缓冲，用于向音频设备输送PCM
+/// 生产者通过reserve拿到最多两段连续的空闲区域直接写入(例如作为swr_convert的输出)，再commit发布；
+/// 消费者read一次最多两次memcpy，数据已经开始流动后仍读不满才记一次欠载。
+/// 消费者通常是音频设备的实时回调，read只有原子读写，不拿锁也不唤醒谁；生产者等待空间时自己定时轮询。
+/// 容量不要求是2的幂，调用方应取采样帧字节数的整数倍，这样两段区域和每次读写都按整帧对齐。
+class PcmRing
+{
+public:
+    explicit PcmRing(size_t capacity) : capacity_(capacity), buffer_(new uint8_t[capacity])
+    {
+    }
+    PcmRing(const PcmRing &) = delete;
+    PcmRing &operator=(const PcmRing &) = delete;
+
+    /// @brief 生产者：取得当前空闲区域，first从写位置到缓冲末尾，second从缓冲开头开始
+    /// @return 空闲字节总数
+    size_t reserve(uint8_t **first, size_t *firstLen, uint8_t **second, size_t *secondLen)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t free = capacity_ - (tail - head_.load(std::memory_order_acquire));
+        const size_t pos = tail % capacity_;
+        const size_t toEnd = capacity_ - pos;
+        *first = buffer_.get() + pos;
+        *firstLen = free < toEnd ? free : toEnd;
+        *second = buffer_.get();
+        *secondLen = free - *firstLen;
+        return free;
+    }
+
+    /// @brief 生产者：发布reserve区域中已写入的前n个字节
+    void commit(size_t n)
+    {
+        tail_.store(tail_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    /// @brief 生产者：等待至少n个字节的空闲空间，n超过容量时按容量等待
+    /// 先让出几次CPU，之后每kPollInterval检查一次；环容纳的时长远大于轮询间隔，不会因此欠载
+    /// @return 环已关闭时返回false
+    bool wait_writable(size_t n)
+    {
+        if (n > capacity_)
+            n = capacity_;
+        for (int i = 0; !closed_.load(std::memory_order_acquire) && capacity_ - size() < n; ++i)
+        {
+            if (i < kSpinCount)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(kPollInterval);
+        }
+        return !closed_.load(std::memory_order_acquire);
+    }
+
+    /// @brief 消费者：读出最多len个字节，不等待
+    /// 第一次读到数据之前(启动时)和环关闭之后(生产者已到结尾或已停止)读不满是正常的，不算欠载
+    /// @param underrun 不为空时写入这次是否记了欠载
+    /// @return 实际读出的字节数
+    size_t read(uint8_t *dst, size_t len, bool *underrun = nullptr)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        const size_t ready = tail_.load(std::memory_order_acquire) - head;
+        const size_t n = len < ready ? len : ready;
+        const size_t pos = head % capacity_;
+        const size_t toEnd = capacity_ - pos;
+        if (n <= toEnd)
+        {
+            memcpy(dst, buffer_.get() + pos, n);
+        }
+        else
+        {
+            memcpy(dst, buffer_.get() + pos, toEnd);
+            memcpy(dst + toEnd, buffer_.get(), n - toEnd);
+        }
+        head_.store(head + n, std::memory_order_release);
+        const bool short_read = n < len && flowing_ && !closed_.load(std::memory_order_acquire);
+        if (short_read)
+            underruns_.fetch_add(1, std::memory_order_relaxed);
+        if (underrun)
+            *underrun = short_read;
+        if (n > 0)
+            flowing_ = true;
+        return n;
+    }
+
+    /// @brief 关闭环，等待空间的生产者在下一次轮询时返回，消费者从不阻塞
+    void close()
+    {
+        closed_.store(true, std::memory_order_release);
+    }
+    bool closed() const
+    {
+        return closed_.load(std::memory_order_acquire);
+    }
+
+    /// @brief 当前可读的字节数，可以在生产者和消费者之外的线程调用，并发时是近似值，但总在[0, capacity]之内
+    size_t size() const
+    {
+        // 先读head再读tail：两者只增不减，读到的tail不会早于head，差值不会回绕成巨大的数；
+        // 两次读取之间对端可能又读写了一轮，差值可能超过容量，截到容量
+        const size_t head = head_.load(std::memory_order_acquire);
+        const size_t n = tail_.load(std::memory_order_acquire) - head;
+        return n < capacity_ ? n : capacity_;
+    }
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+    /// @brief 数据流动期间read没能读满的次数
+    uint64_t underruns() const
+    {
+        return underruns_.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr int kSpinCount = 64;
+    static constexpr std::chrono::milliseconds kPollInterval{5};
+
+    const size_t capacity_;
+    std::unique_ptr<uint8_t[]> buffer_;
+
+    alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+    alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+
+    // 只由消费者读写
+    bool flowing_ = false;
+
+    alignas(kCacheLineSize) std::atomic<uint64_t> underruns_{0};
+    std::atomic<bool> closed_{false};
+};
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef SPSCQ_H
+#define SPSCQ_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+
+// 缓存行大小，head与tail各占一行，避免生产者和消费者互相伪共享
+constexpr size_t kCacheLineSize = 64;
+
+/// @brief 单生产者单消费者无锁环形队列
+/// try_push/try_pop 只做一次原子读写，不加锁也不等待，适合在SDL音频回调这类实时线程中使用；
+/// push/pop 是阻塞版本，队列满/空时先让出几次CPU，仍然不行才退化为条件变量等待，只有等待方拿锁；
+/// 对端读写时从不拿锁，只在确实有人等待时不加锁地notify，因此可能错过一次唤醒，等待方每次最多睡kWaitSlice兜底。
+/// 容量会向上取整为2的幂，用掩码代替取模。
+/// close()的语义与OkQueue一致：之后push失败，pop取完剩余元素后返回std::nullopt。
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t size) : capacity_(roundUpPow2(size)), mask_(capacity_ - 1),
+                                      slots_(new T[capacity_])
+    {
+    }
+    ~SpscQueue()
+    {
+    }
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    /// @brief 尝试入队，队列满时立即返回false，此时item不会被移动
+    template <typename U>
+    bool try_push(U &&item)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ == capacity_)
+        {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ == capacity_)
+                return false;
+        }
+        slots_[tail & mask_] = std::forward<U>(item);
+        tail_.store(tail + 1, std::memory_order_release);
+        wake(consumerWaiting_, notEmpty_);
+        return true;
+    }
+
+    /// @brief 尝试出队，队列空时立即返回false
+    bool try_pop(T &out)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_)
+                return false;
+        }
+        out = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        wake(producerWaiting_, notFull_);
+        return true;
+    }
+
+    /// @brief 阻塞入队，队列满时等待消费者腾出空间
+    /// @return 队列已关闭时返回false
+    bool push(T item)
+    {
+        while (!closed_.load(std::memory_order_acquire))
+        {
+            if (try_push(std::move(item)))
+                return true;
+            wait(producerWaiting_, notFull_, [this]()
+                 { return closed_.load(std::memory_order_acquire) || size() < capacity_; });
+        }
+        return false;
+    }
+
+    /// @brief 阻塞出队，队列空时等待生产者写入
+    /// @return 队列关闭且已取空时返回std::nullopt
+    std::optional<T> pop()
+    {
+        T item;
+        while (!try_pop(item))
+        {
+            if (closed_.load(std::memory_order_acquire))
+            {
+                // close之前入队的元素仍要取出来
+                if (try_pop(item))
+                    break;
+                return std::nullopt;
+            }
+            wait(consumerWaiting_, notEmpty_, [this]()
+                 { return closed_.load(std::memory_order_acquire) || size() > 0; });
+        }
+        return std::optional<T>(std::move(item));
+    }
+
+    /// @brief 最多等待timeout的出队，超时或队列关闭且已取空时返回std::nullopt
+    template <typename Rep, typename Period>
+    std::optional<T> pop_for(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        T item;
+        if (try_pop(item))
+            return std::optional<T>(std::move(item));
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        wait(consumerWaiting_, notEmpty_, [this]()
+             { return closed_.load(std::memory_order_acquire) || size() > 0; },
+             &deadline);
+        if (try_pop(item))
+            return std::optional<T>(std::move(item));
+        return std::nullopt;
+    }
+
+    /// @brief 关闭队列并唤醒两端等待的线程
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        closed_.store(true, std::memory_order_release);
+        notFull_.notify_all();
+        notEmpty_.notify_all();
+    }
+    bool closed() const
+    {
+        return closed_.load(std::memory_order_acquire);
+    }
+
+    /// @brief 当前元素个数，可以在生产者和消费者之外的线程调用，并发时是近似值，但总在[0, capacity]之内
+    size_t size() const
+    {
+        // 先读head再读tail：两者只增不减，读到的tail不会早于head，差值不会回绕成巨大的数；
+        // 两次读取之间对端可能又读写了一轮，差值可能超过容量，截到容量
+        const size_t head = head_.load(std::memory_order_acquire);
+        const size_t n = tail_.load(std::memory_order_acquire) - head;
+        return n < capacity_ ? n : capacity_;
+    }
+    bool empty() const
+    {
+        return size() == 0;
+    }
+    size_t capacity() const
+    {
+        return capacity_;
+    }
+
+private:
+    // 阻塞前先让出CPU的次数
+    static constexpr int kSpinCount = 64;
+    // 等待方每次最多睡的时长：唤醒方不拿锁，通知可能落在等待方检查条件之后、睡下之前而丢失，最多因此多等这么久
+    static constexpr std::chrono::milliseconds kWaitSlice{5};
+
+    static size_t roundUpPow2(size_t size)
+    {
+        size_t capacity = 1;
+        while (capacity < size)
+            capacity <<= 1;
+        return capacity;
+    }
+
+    // deadline为空时一直等到ready()成立
+    template <typename Pred>
+    void wait(std::atomic<bool> &waiting, std::condition_variable &cond, Pred ready,
+              const std::chrono::steady_clock::time_point *deadline = nullptr)
+    {
+        for (int i = 0; i < kSpinCount; ++i)
+        {
+            if (ready())
+                return;
+            std::this_thread::yield();
+        }
+        std::unique_lock<std::mutex> lock(mtx_);
+        waiting.store(true, std::memory_order_relaxed);
+        // 与wake中的栅栏配对：要么这里看到对端的新下标，要么对端看到waiting为true并发出通知
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!ready())
+        {
+            const auto now = std::chrono::steady_clock::now();
+            if (deadline && now >= *deadline)
+                break;
+            auto until = now + kWaitSlice;
+            if (deadline && *deadline < until)
+                until = *deadline;
+            cond.wait_until(lock, until);
+        }
+        waiting.store(false, std::memory_order_relaxed);
+    }
+
+    // 不拿锁，读写下标的一端(包括实时线程)不会因为对端在等待而阻塞在互斥锁上
+    void wake(std::atomic<bool> &waiting, std::condition_variable &cond)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting.load(std::memory_order_relaxed))
+            cond.notify_one();
+    }
+
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<T[]> slots_;
+
+    // 消费者独占：读下标及其看到的写下标缓存
+    alignas(kCacheLineSize) std::atomic<size_t> head_{0};
+    size_t cachedTail_ = 0;
+    // 生产者独占：写下标及其看到的读下标缓存
+    alignas(kCacheLineSize) std::atomic<size_t> tail_{0};
+    size_t cachedHead_ = 0;
+
+    // 阻塞回退路径，只有等待方和close才会拿锁
+    alignas(kCacheLineSize) std::atomic<bool> consumerWaiting_{false};
+    std::atomic<bool> producerWaiting_{false};
+    std::atomic<bool> closed_{false};
+    std::mutex mtx_;
+    std::condition_variable notFull_;
+    std::condition_variable notEmpty_;
+};
+
+#endif
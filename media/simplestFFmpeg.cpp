@@ -47,7 +47,7 @@ void startRender(const GLuint *texture, GLuint &vao, GLuint &ebo, GLFWwindow *wi
         return;
     }
     double startTime = 0;
-    auto videoMessage = videoFrameQueue->pop();
+    auto videoMessage = *videoFrameQueue->pop();
     if (videoMessage->status == StatusPreparing)
     {
         // 初始化纹理
@@ -93,7 +93,7 @@ void startRender(const GLuint *texture, GLuint &vao, GLuint &ebo, GLFWwindow *wi
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
         glBindVertexArray(1);
-        videoMessage = videoFrameQueue->pop();
+        videoMessage = *videoFrameQueue->pop();
         VedioFrame *frame = videoMessage->frame;
         if (frame == nullptr)
         {
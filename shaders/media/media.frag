@@ -5,6 +5,11 @@ uniform bool useTexture;
 uniform sampler2D textureY;
 uniform sampler2D textureU;
 uniform sampler2D textureV;
+// 高位深纹理的归一化系数，8位时为1
+uniform float sampleScale;
+// YUV到RGB的矩阵和偏移，由帧的矩阵系数和色彩范围计算得到，rgb = colorMatrix * (yuv - colorOffset)
+uniform mat3 colorMatrix;
+uniform vec3 colorOffset;
 
 out vec4 FragColor;
 
@@ -15,11 +20,12 @@ void main() {
     //YUV to RGB
         vec3 yuv;
         yuv.x = texture(textureY, myTexcoord).r;
-        yuv.y = texture(textureU, myTexcoord).r - 0.5;
-        yuv.z = texture(textureV, myTexcoord).r - 0.5;
+        yuv.y = texture(textureU, myTexcoord).r;
+        yuv.z = texture(textureV, myTexcoord).r;
+        yuv = yuv * sampleScale;
 
 
-        vec3 rgb = mat3(1.0, 1.0, 1.0, 0.0, -0.39465, 2.03211, 1.13983, -0.58060, 0.0) * yuv;
-        FragColor = vec4(rgb, 1.0);
+        vec3 rgb = colorMatrix * (yuv - colorOffset);
+        FragColor = vec4(clamp(rgb, 0.0, 1.0), 1.0);
     }
 }
\ No newline at end of file
@@ -0,0 +1,30 @@
+#version 330 core
+
+in vec2 myTexcoord;
+uniform bool useTexture;
+uniform sampler2D textureY;
+// NV12的UV交错存放，r为U，g为V
+uniform sampler2D textureUV;
+// 高位深纹理(P010)的归一化系数，8位时为1
+uniform float sampleScale;
+// YUV到RGB的矩阵和偏移，由帧的矩阵系数和色彩范围计算得到，rgb = colorMatrix * (yuv - colorOffset)
+uniform mat3 colorMatrix;
+uniform vec3 colorOffset;
+
+out vec4 FragColor;
+
+void main() {
+    if(!useTexture) {
+        FragColor = vec4(0.2, 0.4, 0.8, 1.0);
+    } else {
+    //YUV to RGB
+        vec3 yuv;
+        yuv.x = texture(textureY, myTexcoord).r;
+        yuv.yz = texture(textureUV, myTexcoord).rg;
+        yuv = yuv * sampleScale;
+
+
+        vec3 rgb = colorMatrix * (yuv - colorOffset);
+        FragColor = vec4(clamp(rgb, 0.0, 1.0), 1.0);
+    }
+}
@@ -1,12 +1,35 @@
 #include <Program/shader.h>
+#include <common/gl_ext.h>
 #include <glm/gtc/type_ptr.hpp>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+#include <chrono>
+#include <thread>
 
 
 using namespace std;
 
-Shader::Shader(const char* vertexSourcePath, const char* fragmentSourcePath) {
-	string vertexCode;
-	string fragmentCode;
+// 程序二进制缓存目录，相对于工作目录，与shaders目录并列
+static const char* PROGRAM_CACHE_DIR = "shader_cache";
+// 缓存文件头的魔数，文件格式变化时修改
+static const uint32_t PROGRAM_CACHE_MAGIC = 0x31504D53; // "SMP1"
+
+// FNV-1a 64位哈希
+static uint64_t fnv1a(uint64_t hash, const char* data, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static string cachePath(const string& key) {
+	return string(PROGRAM_CACHE_DIR) + "/" + key + ".bin";
+}
+
+bool Shader::readSources(const char* vertexSourcePath, const char* fragmentSourcePath, string& vertexCode, string& fragmentCode) {
 	ifstream vShaderFile;
 	ifstream fShaderFile;
 	vShaderFile.exceptions(ifstream::failbit | ifstream::badbit);
@@ -15,7 +38,7 @@ Shader::Shader(const char* vertexSourcePath, const char* fragmentSourcePath) {
 	try {
 		if(!vShaderFile.good() || !fShaderFile.good()){
 			cout << "the vertexSourcePath or fragmentSourcePath is not exists" << endl;
-			return;
+			return false;
 		}
 		vShaderFile.open(vertexSourcePath);
 		fShaderFile.open(fragmentSourcePath);
@@ -30,40 +53,188 @@ Shader::Shader(const char* vertexSourcePath, const char* fragmentSourcePath) {
 	catch (ifstream::failure e) {
 		std::cout << "init shader source failed: " << endl;
 	}
+	return true;
+}
 
-	const char* vShaderCode = vertexCode.c_str();
-	const char* fShaderCode = fragmentCode.c_str();
+Shader::Shader(const char* vertexSourcePath, const char* fragmentSourcePath) {
+	string vertexCode;
+	string fragmentCode;
+	if (!readSources(vertexSourcePath, fragmentSourcePath, vertexCode, fragmentCode)) {
+		return;
+	}
 
-	compileAndLink(vShaderCode, fShaderCode);
+	// 优先使用上次链接好的程序二进制，不匹配时回退到编译
+	string key = binaryCacheKey(vertexCode, fragmentCode);
+	if (!loadBinary(key)) {
+		unsigned int vertex, fragment;
+		submit(vertexCode.c_str(), fragmentCode.c_str(), vertex, fragment);
+		finish(vertex, fragment);
+		saveBinary(key);
+	}
+	cacheUniforms();
+}
 
+vector<unique_ptr<Shader>> Shader::createBatch(const vector<ShaderSource>& sources) {
+	struct Pending {
+		string key;
+		unsigned int vertex = 0;
+		unsigned int fragment = 0;
+		bool compiling = false;
+	};
+	vector<unique_ptr<Shader>> shaders;
+	vector<Pending> pending(sources.size());
+	// 第一步：能从二进制缓存加载的直接加载，其余只提交编译和链接，不查询任何状态，
+	// 驱动不会因为查询而被迫同步等待，各程序的编译可以在驱动内部并行
+	for (size_t i = 0; i < sources.size(); i++) {
+		shaders.emplace_back(new Shader());
+		string vertexCode;
+		string fragmentCode;
+		if (!readSources(sources[i].vertexPath, sources[i].fragmentPath, vertexCode, fragmentCode)) {
+			continue;
+		}
+		pending[i].key = binaryCacheKey(vertexCode, fragmentCode);
+		if (!shaders[i]->loadBinary(pending[i].key)) {
+			shaders[i]->submit(vertexCode.c_str(), fragmentCode.c_str(), pending[i].vertex, pending[i].fragment);
+			pending[i].compiling = true;
+		}
+	}
+	// 第二步：支持KHR_parallel_shader_compile时轮询完成状态，不支持时第三步的状态查询会逐个阻塞
+	if (glExt.parallelShaderCompile) {
+		bool done = false;
+		while (!done) {
+			done = true;
+			for (size_t i = 0; i < shaders.size(); i++) {
+				GLint complete = GL_TRUE;
+				if (pending[i].compiling) {
+					glGetProgramiv(shaders[i]->ProgramId, GL_COMPLETION_STATUS_KHR, &complete);
+				}
+				done = done && complete == GL_TRUE;
+			}
+			if (!done) {
+				this_thread::sleep_for(chrono::milliseconds(1));
+			}
+		}
+	}
+	// 第三步：读取状态和日志，写入缓存
+	for (size_t i = 0; i < shaders.size(); i++) {
+		if (pending[i].compiling) {
+			shaders[i]->finish(pending[i].vertex, pending[i].fragment);
+			shaders[i]->saveBinary(pending[i].key);
+		}
+		shaders[i]->cacheUniforms();
+	}
+	return shaders;
 }
 
-void Shader::compileAndLink(const char* vertexCode, const char* fragmentCode) {
-	unsigned int vertex, fragment;
+string Shader::binaryCacheKey(const string& vertexCode, const string& fragmentCode) {
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	hash = fnv1a(hash, vertexCode.data(), vertexCode.size() + 1);
+	hash = fnv1a(hash, fragmentCode.data(), fragmentCode.size() + 1);
+	// 二进制只对生成它的驱动有效
+	for (GLenum info : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+		const char* str = (const char*)glGetString(info);
+		if (str) {
+			hash = fnv1a(hash, str, strlen(str) + 1);
+		}
+	}
+	stringstream ss;
+	ss << hex << hash;
+	return ss.str();
+}
+
+bool Shader::loadBinary(const string& key) {
+	if (!glExt.programBinary) {
+		return false;
+	}
+	ifstream in(cachePath(key), ios::binary);
+	if (!in) {
+		return false;
+	}
+	uint32_t magic = 0;
+	GLenum format = 0;
+	in.read((char*)&magic, sizeof(magic));
+	in.read((char*)&format, sizeof(format));
+	if (!in || magic != PROGRAM_CACHE_MAGIC) {
+		return false;
+	}
+	// 头部之后直到文件末尾都是二进制；istreambuf_iterator读完不会设置eofbit，不能再用eof()判断
+	vector<char> binary((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+	if (binary.empty()) {
+		return false;
+	}
+	ProgramId = glCreateProgram();
+	glExt.programBinary(ProgramId, format, binary.data(), (GLsizei)binary.size());
 	int success;
-	char infoLog[512];
+	glGetProgramiv(ProgramId, GL_LINK_STATUS, &success);
+	if (!success) {
+		// 驱动拒绝了二进制(格式不支持或内部版本变化)，重新编译并覆盖缓存
+		cout << "program binary cache rejected, recompiling: " << key << endl;
+		glDeleteProgram(ProgramId);
+		ProgramId = 0;
+		return false;
+	}
+	return true;
+}
+
+void Shader::saveBinary(const string& key) {
+	if (!glExt.getProgramBinary) {
+		return;
+	}
+	int success;
+	glGetProgramiv(ProgramId, GL_LINK_STATUS, &success);
+	GLint length = 0;
+	glGetProgramiv(ProgramId, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (!success || length <= 0) {
+		return;
+	}
+	vector<char> binary(length);
+	GLenum format = 0;
+	glExt.getProgramBinary(ProgramId, length, &length, &format, binary.data());
+	error_code ec;
+	filesystem::create_directories(PROGRAM_CACHE_DIR, ec);
+	ofstream out(cachePath(key), ios::binary | ios::trunc);
+	if (ec || !out) {
+		cout << "write program binary cache failed: " << key << endl;
+		return;
+	}
+	out.write((const char*)&PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+	out.write((const char*)&format, sizeof(format));
+	out.write(binary.data(), length);
+}
+
+void Shader::submit(const char* vertexCode, const char* fragmentCode, unsigned int& vertex, unsigned int& fragment) {
 	//顶点着色器
 	vertex = glCreateShader(GL_VERTEX_SHADER);
 	glShaderSource(vertex, 1, &vertexCode, NULL);
 	glCompileShader(vertex);
+
+	fragment = glCreateShader(GL_FRAGMENT_SHADER);
+	glShaderSource(fragment, 1, &fragmentCode, NULL);
+	glCompileShader(fragment);
+
+	ProgramId = glCreateProgram();
+	// 提示驱动保留可取回的二进制，供写入缓存
+	if (glExt.programParameteri) {
+		glExt.programParameteri(ProgramId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glAttachShader(ProgramId, vertex);
+	glAttachShader(ProgramId, fragment);
+	glLinkProgram(ProgramId);
+}
+
+void Shader::finish(unsigned int vertex, unsigned int fragment) {
+	int success;
+	char infoLog[512];
 	glGetShaderiv(vertex, GL_COMPILE_STATUS, &success);
 	if (!success) {
 		glGetShaderInfoLog(vertex, 512, NULL, infoLog);
 		cout << "create vertex shader failed:" << infoLog << endl;
 	}
-
-	fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &fragmentCode, NULL);
-	glCompileShader(fragment);
 	glGetShaderiv(fragment, GL_COMPILE_STATUS, &success);
 	if (!success) {
 		glGetShaderInfoLog(fragment, 512, NULL, infoLog);
 		cout << "create fragment shader failed:" << infoLog << endl;
 	}
-	ProgramId = glCreateProgram();
-	glAttachShader(ProgramId, vertex);
-	glAttachShader(ProgramId, fragment);
-	glLinkProgram(ProgramId);
 	glGetProgramiv(ProgramId, GL_LINK_STATUS, &success);
 	if (!success) {
 		glGetProgramInfoLog(ProgramId, 512, NULL, infoLog);
@@ -72,7 +243,36 @@ void Shader::compileAndLink(const char* vertexCode, const char* fragmentCode) {
 	//着色器已经链接至程序中，删除它
 	glDeleteShader(vertex);
 	glDeleteShader(fragment);
+}
 
+void Shader::cacheUniforms() {
+	uniforms.clear();
+	GLint count = 0, maxLength = 0;
+	glGetProgramiv(ProgramId, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(ProgramId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	string name(maxLength > 0 ? maxLength : 1, '\0');
+	for (GLint i = 0; i < count; i++) {
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(ProgramId, (GLuint)i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+		string uniformName = name.substr(0, length);
+		// uniform块里的成员没有位置
+		GLint location = glGetUniformLocation(ProgramId, uniformName.c_str());
+		if (location < 0) {
+			continue;
+		}
+		// 数组返回的名字是"name[0]"，同时登记不带下标的名字
+		if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+			uniforms[uniformName.substr(0, uniformName.size() - 3)] = location;
+		}
+		uniforms[uniformName] = location;
+	}
+}
+
+GLint Shader::uniformLocation(string_view name) const {
+	auto it = uniforms.find(name);
+	return it == uniforms.end() ? -1 : it->second;
 }
 
 void Shader::use() {
@@ -80,42 +280,76 @@ void Shader::use() {
 }
 
 
-void Shader::setFloat(string& name, float value) {
-	glUniform1f(glGetUniformLocation(ProgramId, name.c_str()), value);
+void Shader::setInt(GLint location, int value) {
+	glUniform1i(location, value);
+}
+
+void Shader::setBool(GLint location, bool value) {
+	glUniform1i(location, value);
+}
+
+void Shader::setFloat(GLint location, float value) {
+	glUniform1f(location, value);
+}
+
+void Shader::setMat3(GLint location, const glm::mat3& value) {
+	glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setMat4(GLint location, const glm::mat4& value) {
+	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
 }
 
-void Shader::setInt(string& name, int value) {
-	glUniform1i(glGetUniformLocation(ProgramId, name.c_str()), value);
+void Shader::setVec3(GLint location, const glm::vec3& value) {
+	glUniform3fv(location, 1, glm::value_ptr(value));
 }
 
 
-void Shader::setBool(string& name, bool value) {
-	glUniform1i(glGetUniformLocation(ProgramId, name.c_str()), value);
+void Shader::setFloat(string_view name, float value) {
+	setFloat(uniformLocation(name), value);
+}
+
+void Shader::setInt(string_view name, int value) {
+	setInt(uniformLocation(name), value);
 }
 
-void Shader::setMat4(string& name, glm::mat4& value) {
-	glUniformMatrix4fv(glGetUniformLocation(ProgramId, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+
+void Shader::setBool(string_view name, bool value) {
+	setBool(uniformLocation(name), value);
+}
+
+void Shader::setMat4(string_view name, const glm::mat4& value) {
+	setMat4(uniformLocation(name), value);
 }
 
 
 void Shader::setFloatP(const char* name, float value) {
-	glUniform1f(glGetUniformLocation(ProgramId, name), value);
+	setFloat(uniformLocation(name), value);
 }
 
 void Shader::setIntP(const char* name, int value) {
-	glUniform1i(glGetUniformLocation(ProgramId, name), value);
+	setInt(uniformLocation(name), value);
 }
 
 
 void Shader::setBoolP(const char* name, bool value) {
-	glUniform1i(glGetUniformLocation(ProgramId, name), value);
+	setBool(uniformLocation(name), value);
 }
 
 void Shader::setMat4P(const char* name, glm::mat4& value) {
-	glUniformMatrix4fv(glGetUniformLocation(ProgramId, name), 1, GL_FALSE, glm::value_ptr(value));
+	setMat4(uniformLocation(name), value);
+}
+
+void Shader::setMat3P(const char* name, const glm::mat3& value) {
+	setMat3(uniformLocation(name), value);
+}
+
+void Shader::setVec3P(const char* name, const glm::vec3& value) {
+	setVec3(uniformLocation(name), value);
 }
 
 void Shader::release() {
 	glDeleteProgram(ProgramId);
+	uniforms.clear();
 }
 
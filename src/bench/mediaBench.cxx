@@ -0,0 +1,156 @@
+// 解码吞吐基准：不限速地把整个文件跑完一遍媒体流水线，以JSON输出帧率、各阶段耗时和峰值内存
+// 用法: MediaBench [文件] [--no-render] [--no-audio] [--window] [--threads N] [--threading auto|frame|slice] [--trace 文件]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include "media/include/player.h"
+
+const char *DEFAULT_FILE = "media/Titanic.ts";
+
+static void usage(const char *program)
+{
+    std::cerr << "用法: " << program
+              << " [文件] [--no-render] [--no-audio] [--window] [--threads N] [--threading auto|frame|slice] [--trace 文件]" << std::endl;
+}
+
+/// @brief 把字符串写成JSON字符串字面量
+static std::string jsonString(const std::string &value)
+{
+    std::string out = "\"";
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        if ((unsigned char)c < 0x20)
+        {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+            continue;
+        }
+        out += c;
+    }
+    return out + "\"";
+}
+
+/// @brief 进程的峰值常驻内存，单位KB
+static long peakRssKb()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#ifdef __APPLE__
+    // macOS上ru_maxrss的单位是字节，Linux上是KB
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+/// @brief 单个阶段的延迟分布(微秒)
+static std::string jsonLatency(const HistogramSummary &summary)
+{
+    return "{\"count\": " + std::to_string(summary.count) + ", \"p50\": " + std::to_string(summary.p50) +
+           ", \"p90\": " + std::to_string(summary.p90) + ", \"p99\": " + std::to_string(summary.p99) +
+           ", \"max\": " + std::to_string(summary.max) + "}";
+}
+
+int main(int argc, char **argv)
+{
+    std::string file = DEFAULT_FILE;
+    PlayerOptions options;
+    options.unpaced = true;
+    options.headless = true;
+    // 音频数据尽快拉走丢弃，不让声卡的节奏拖慢解码
+    options.audio_output = AudioOutput::Null;
+    options.audio_paced = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--no-render") == 0)
+            options.skip_render = true;
+        else if (strcmp(argv[i], "--no-audio") == 0)
+            options.skip_audio = true;
+        else if (strcmp(argv[i], "--window") == 0)
+            options.headless = false;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            options.decoder_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            options.trace_file = argv[++i];
+        else if (strcmp(argv[i], "--threading") == 0 && i + 1 < argc)
+        {
+            const char *mode = argv[++i];
+            if (strcmp(mode, "frame") == 0)
+                options.decoder_threading = DecodeThreading::Frame;
+            else if (strcmp(mode, "slice") == 0)
+                options.decoder_threading = DecodeThreading::Slice;
+            else
+                options.decoder_threading = DecodeThreading::Auto;
+        }
+        else if (argv[i][0] == '-')
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        else
+            file = argv[i];
+    }
+
+    // 播放器和着色器的日志写到std::cout，运行期间转到std::clog，保证标准输出只有JSON
+    std::streambuf *out = std::cout.rdbuf(std::clog.rdbuf());
+    double initStart = Clock::Now();
+    MediaPlayer player(file, 800, 600, options);
+    double initTime = Clock::Now() - initStart;
+    if (!player.IsReady())
+    {
+        std::cout.rdbuf(out);
+        std::cerr << "初始化失败: " << file << std::endl;
+        return 1;
+    }
+    player.Play();
+    player.Stop();
+    std::cout.rdbuf(out);
+
+    PlayerStats stats = player.Stats();
+    TelemetrySnapshot telemetry = player.Telemetry();
+    double fps = stats.play_time > 0 ? stats.video_frames_decoded / stats.play_time : 0;
+    std::cout.setf(std::ios::fixed);
+    std::cout.precision(6);
+    std::cout << "{\n"
+              << "  \"file\": " << jsonString(file) << ",\n"
+              << "  \"render\": " << (options.skip_render ? "false" : "true") << ",\n"
+              << "  \"audio\": " << (options.skip_audio ? "false" : "true") << ",\n"
+              << "  \"decoder_threads\": " << options.decoder_threads << ",\n"
+              << "  \"init_sec\": " << initTime << ",\n"
+              << "  \"wall_sec\": " << stats.play_time << ",\n"
+              << "  \"fps\": " << fps << ",\n"
+              << "  \"packets\": " << stats.packets << ",\n"
+              << "  \"video_frames_decoded\": " << stats.video_frames_decoded << ",\n"
+              << "  \"video_frames_presented\": " << stats.video_frames_presented << ",\n"
+              << "  \"audio_samples\": " << stats.audio_samples << ",\n"
+              << "  \"stage_sec\": {\n"
+              << "    \"demux\": " << stats.demux_time << ",\n"
+              << "    \"video_decode\": " << stats.video_decode_time << ",\n"
+              << "    \"sws\": " << stats.sws_time << ",\n"
+              << "    \"pbo_copy\": " << stats.pbo_copy_time << ",\n"
+              << "    \"audio_decode\": " << stats.audio_decode_time << ",\n"
+              << "    \"resample\": " << stats.resample_time << ",\n"
+              << "    \"upload\": " << stats.upload_time << ",\n"
+              << "    \"render\": " << stats.render_time << "\n"
+              << "  },\n"
+              << "  \"latency_us\": {\n"
+              << "    \"decode\": " << jsonLatency(telemetry.decode) << ",\n"
+              << "    \"convert\": " << jsonLatency(telemetry.convert) << ",\n"
+              << "    \"queue\": " << jsonLatency(telemetry.queue) << ",\n"
+              << "    \"upload\": " << jsonLatency(telemetry.upload) << ",\n"
+              << "    \"present\": " << jsonLatency(telemetry.present) << ",\n"
+              << "    \"total\": " << jsonLatency(telemetry.total) << "\n"
+              << "  },\n"
+              << "  \"frame_drops_late\": " << stats.frame_drops_late << ",\n"
+              << "  \"frame_drops_early\": " << stats.frame_drops_early << ",\n"
+              << "  \"peak_rss_kb\": " << peakRssKb() << "\n"
+              << "}" << std::endl;
+    return 0;
+}
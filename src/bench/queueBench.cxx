@@ -0,0 +1,282 @@
+// 线程间队列的微基准：OkQueue、SpscQueue、VideoFrameQueue在不同容量、负载大小和生产者/消费者个数下的
+// 吞吐量与交接延迟(p50/p99)，交接延迟指生产者入队前到消费者出队后的时间；
+// 生产者不限速，队列基本处于满的状态，所以延迟主要反映排队深度，容量越大延迟越高
+// 用法: QueueBench [--items N] [--threads N] [--json]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <toolkit/bufferq.h>
+#include <toolkit/spscq.h>
+#include "media/simplestFFmpeg.h"
+
+// 被测的队列容量，负载字节数见runPayloads
+const size_t CAPACITIES[] = {16, 256, 4096};
+const size_t DEFAULT_ITEMS = 200000;
+
+static int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/// @brief N字节的负载，开头是入队时间戳
+template <size_t N>
+struct Payload
+{
+    int64_t stamp;
+    uint8_t data[N - sizeof(int64_t)];
+};
+
+/// @brief VideoFrameQueue只传指针，负载放在消息对象里，和播放器一样每条消息new出来、消费后delete
+template <size_t N>
+class BenchMessage : public VideoMessage
+{
+public:
+    explicit BenchMessage(int64_t stamp) : VideoMessage(0, 0, StatusPlaying, nullptr)
+    {
+        payload.stamp = stamp;
+    }
+    Payload<N> payload;
+};
+
+// 以下适配器把各队列统一成push/pop/finish三个操作；pop返回false表示数据已取完
+
+template <size_t N>
+class OkQueueBench
+{
+public:
+    static constexpr const char *NAME = "OkQueue";
+    explicit OkQueueBench(size_t capacity) : queue_((int)capacity) {}
+    void push(int64_t stamp)
+    {
+        Payload<N> payload;
+        payload.stamp = stamp;
+        queue_.push(payload);
+    }
+    bool pop(int64_t &stamp)
+    {
+        std::optional<Payload<N>> payload = queue_.pop();
+        if (!payload)
+            return false;
+        stamp = payload->stamp;
+        return true;
+    }
+    void finish(int)
+    {
+        queue_.close();
+    }
+
+private:
+    OkQueue<Payload<N>> queue_;
+};
+
+template <size_t N>
+class SpscQueueBench
+{
+public:
+    static constexpr const char *NAME = "SpscQueue";
+    explicit SpscQueueBench(size_t capacity) : queue_(capacity) {}
+    void push(int64_t stamp)
+    {
+        Payload<N> payload;
+        payload.stamp = stamp;
+        queue_.push(payload);
+    }
+    bool pop(int64_t &stamp)
+    {
+        std::optional<Payload<N>> payload = queue_.pop();
+        if (!payload)
+            return false;
+        stamp = payload->stamp;
+        return true;
+    }
+    void finish(int)
+    {
+        queue_.close();
+    }
+
+private:
+    SpscQueue<Payload<N>> queue_;
+};
+
+template <size_t N>
+class VideoFrameQueueBench
+{
+public:
+    static constexpr const char *NAME = "VideoFrameQueue";
+    // 环形缓冲空出一格区分空和满，多分配一格使可用容量与其它队列一致
+    explicit VideoFrameQueueBench(size_t capacity) : queue_((int)capacity + 1) {}
+    void push(int64_t stamp)
+    {
+        queue_.push(new BenchMessage<N>(stamp));
+    }
+    bool pop(int64_t &stamp)
+    {
+        VideoMessage *msg = queue_.pop();
+        if (!msg)
+            return false;
+        stamp = static_cast<BenchMessage<N> *>(msg)->payload.stamp;
+        delete msg;
+        return true;
+    }
+    // 没有close，给每个消费者放一个空指针作为结束标记
+    void finish(int consumers)
+    {
+        for (int i = 0; i < consumers; ++i)
+            queue_.push(nullptr);
+    }
+
+private:
+    VideoFrameQueue queue_;
+};
+
+struct Result
+{
+    const char *queue;
+    int producers;
+    int consumers;
+    size_t capacity;
+    size_t payload;
+    size_t items;
+    double seconds;
+    int64_t p50;
+    int64_t p99;
+};
+
+template <typename Queue>
+static Result run(int producers, int consumers, size_t capacity, size_t payload, size_t items)
+{
+    Queue queue(capacity);
+    std::vector<std::vector<int64_t>> latencies(consumers);
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    auto waitStart = [&]()
+    {
+        ready.fetch_add(1);
+        while (!go.load(std::memory_order_acquire))
+            std::this_thread::yield();
+    };
+
+    std::vector<std::thread> producerThreads;
+    std::vector<std::thread> consumerThreads;
+    for (int i = 0; i < consumers; ++i)
+    {
+        latencies[i].reserve(items / consumers + 1);
+        consumerThreads.emplace_back([&, i]()
+                                     {
+            waitStart();
+            int64_t stamp;
+            while (queue.pop(stamp))
+                latencies[i].push_back(nowNs() - stamp); });
+    }
+    for (int i = 0; i < producers; ++i)
+    {
+        // 余数分给第一个生产者
+        size_t count = items / producers + (i == 0 ? items % producers : 0);
+        producerThreads.emplace_back([&, count]()
+                                     {
+            waitStart();
+            for (size_t n = 0; n < count; ++n)
+                queue.push(nowNs()); });
+    }
+
+    // 所有线程就绪后同时开始
+    while (ready.load() < producers + consumers)
+        std::this_thread::yield();
+    int64_t start = nowNs();
+    go.store(true, std::memory_order_release);
+    for (std::thread &t : producerThreads)
+        t.join();
+    queue.finish(consumers);
+    for (std::thread &t : consumerThreads)
+        t.join();
+    double seconds = (nowNs() - start) / 1e9;
+
+    std::vector<int64_t> all;
+    all.reserve(items);
+    for (std::vector<int64_t> &samples : latencies)
+        all.insert(all.end(), samples.begin(), samples.end());
+    std::sort(all.begin(), all.end());
+    auto percentile = [&all](double p)
+    { return all.empty() ? 0 : all[(size_t)((all.size() - 1) * p)]; };
+    return Result{Queue::NAME, producers, consumers, capacity, payload, items, seconds, percentile(0.5), percentile(0.99)};
+}
+
+template <template <size_t> class Queue, size_t N>
+static void runCapacities(int producers, int consumers, size_t items, std::vector<Result> &results)
+{
+    for (size_t capacity : CAPACITIES)
+    {
+        Result result = run<Queue<N>>(producers, consumers, capacity, N, items);
+        fprintf(stderr, "%-16s %dx%-3d %8zu %8zu %14.0f %10lld %10lld\n", result.queue, result.producers, result.consumers,
+                result.capacity, result.payload, result.items / result.seconds, (long long)result.p50, (long long)result.p99);
+        results.push_back(result);
+    }
+}
+
+template <template <size_t> class Queue>
+static void runPayloads(int producers, int consumers, size_t items, std::vector<Result> &results)
+{
+    runCapacities<Queue, 16>(producers, consumers, items, results);
+    runCapacities<Queue, 256>(producers, consumers, items, results);
+    runCapacities<Queue, 4096>(producers, consumers, items, results);
+}
+
+int main(int argc, char **argv)
+{
+    size_t items = DEFAULT_ITEMS;
+    int threads = 4;
+    bool json = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--items") == 0 && i + 1 < argc)
+            items = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--json") == 0)
+            json = true;
+        else
+        {
+            fprintf(stderr, "用法: %s [--items N] [--threads N] [--json]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (items == 0 || threads < 1)
+    {
+        fprintf(stderr, "items与threads必须大于0\n");
+        return 2;
+    }
+
+    // 进度和表格写到stderr，--json时stdout只有结果
+    fprintf(stderr, "%-16s %-5s %8s %8s %14s %10s %10s\n", "queue", "PxC", "capacity", "payload", "items/s", "p50(ns)", "p99(ns)");
+    std::vector<Result> results;
+    // SpscQueue只允许一个生产者和一个消费者
+    runPayloads<SpscQueueBench>(1, 1, items, results);
+    runPayloads<OkQueueBench>(1, 1, items, results);
+    runPayloads<VideoFrameQueueBench>(1, 1, items, results);
+    if (threads > 1)
+    {
+        runPayloads<OkQueueBench>(threads, threads, items, results);
+        runPayloads<VideoFrameQueueBench>(threads, threads, items, results);
+    }
+
+    if (json)
+    {
+        printf("[\n");
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result &r = results[i];
+            printf("  {\"queue\": \"%s\", \"producers\": %d, \"consumers\": %d, \"capacity\": %zu, \"payload\": %zu, "
+                   "\"items\": %zu, \"seconds\": %.6f, \"items_per_sec\": %.0f, \"p50_ns\": %lld, \"p99_ns\": %lld}%s\n",
+                   r.queue, r.producers, r.consumers, r.capacity, r.payload, r.items, r.seconds, r.items / r.seconds,
+                   (long long)r.p50, (long long)r.p99, i + 1 < results.size() ? "," : "");
+        }
+        printf("]\n");
+    }
+    return 0;
+}
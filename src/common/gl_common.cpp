@@ -1,4 +1,5 @@
 #include<common/gl_common.h>
+#include <common/gl_ext.h>
 #include <iostream>
 #include <common/base.h>
 
@@ -30,7 +31,7 @@ GLFWwindow* initWindow(int width, int height, const char* title) {
 
 
 
-GLFWwindow* initGlEnv(int width, int height, const char* title) {
+GLFWwindow* initGlEnv(int width, int height, const char* title, bool visible) {
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -38,6 +39,7 @@ GLFWwindow* initGlEnv(int width, int height, const char* title) {
 	// #ifdef MACOS
 		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 	// #endif
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
 	glfwSetErrorCallback(onGlfwError);
 	GLFWwindow* window = initWindow(width, height, title);
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
@@ -46,6 +48,7 @@ GLFWwindow* initGlEnv(int width, int height, const char* title) {
 		std::cout << "failed init glad!, the error is " << erroState << std::endl;
 		return  NULL;
 	}
+	loadGlExt();
 	return window;
 }
 
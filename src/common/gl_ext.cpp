@@ -0,0 +1,59 @@
+#include <common/gl_ext.h>
+#include <GLFW/glfw3.h>
+#include <iostream>
+
+GlExt glExt;
+
+// 核心版本达到要求或者驱动声明了对应扩展，才认为入口可用；
+// 只看glfwGetProcAddress是否为空不可靠，有的驱动对不支持的函数也会返回地址
+static bool hasFeature(int major, int minor, const char *extension)
+{
+	if (GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor))
+		return true;
+	return glfwExtensionSupported(extension) == GLFW_TRUE;
+}
+
+void loadGlExt()
+{
+	glExt = GlExt();
+	if (hasFeature(4, 4, "GL_ARB_buffer_storage"))
+		glExt.bufferStorage = (PFNGLBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+	if (hasFeature(4, 2, "GL_ARB_texture_storage"))
+		glExt.texStorage2D = (PFNGLTEXSTORAGE2DPROC)glfwGetProcAddress("glTexStorage2D");
+	if (hasFeature(4, 1, "GL_ARB_get_program_binary"))
+	{
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		if (formats > 0)
+		{
+			glExt.getProgramBinary = (PFNGLGETPROGRAMBINARYPROC)glfwGetProcAddress("glGetProgramBinary");
+			glExt.programBinary = (PFNGLPROGRAMBINARYPROC)glfwGetProcAddress("glProgramBinary");
+			glExt.programParameteri = (PFNGLPROGRAMPARAMETERIPROC)glfwGetProcAddress("glProgramParameteri");
+			if (!glExt.getProgramBinary || !glExt.programBinary || !glExt.programParameteri)
+			{
+				glExt.getProgramBinary = nullptr;
+				glExt.programBinary = nullptr;
+				glExt.programParameteri = nullptr;
+			}
+		}
+	}
+	// 纯扩展，没有对应的核心版本；ARB版本的枚举值与KHR相同
+	if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+	{
+		glExt.parallelShaderCompile = true;
+		glExt.maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	}
+	else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+	{
+		glExt.parallelShaderCompile = true;
+		glExt.maxShaderCompilerThreads = (PFNGLMAXSHADERCOMPILERTHREADSKHRPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+	}
+	// 0xFFFFFFFF表示由驱动决定编译线程数
+	if (glExt.maxShaderCompilerThreads)
+		glExt.maxShaderCompilerThreads(0xFFFFFFFF);
+	std::cout << "GL " << GLVersion.major << "." << GLVersion.minor
+			  << ", buffer storage: " << (glExt.bufferStorage ? "yes" : "no")
+			  << ", texture storage: " << (glExt.texStorage2D ? "yes" : "no")
+			  << ", program binary: " << (glExt.programBinary ? "yes" : "no")
+			  << ", parallel shader compile: " << (glExt.parallelShaderCompile ? "yes" : "no") << std::endl;
+}
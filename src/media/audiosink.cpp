@@ -0,0 +1,184 @@
+#include "include/audiosink.h"
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+// 拉取式输出每次拉取的采样帧数，与SDL设备缓冲一致
+const int PULL_CHUNK_SAMPLES = 1024;
+// 16位PCM每个采样的字节数
+const int BYTES_PER_SAMPLE = 2;
+
+SdlAudioSink::~SdlAudioSink()
+{
+    Close();
+}
+
+bool SdlAudioSink::Open(int sampleRate, int channels, Callback callback)
+{
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0)
+    {
+        std::cerr << "SDL初始化失败: " << SDL_GetError() << std::endl;
+        return false;
+    }
+    callback_ = std::move(callback);
+    SDL_AudioSpec wanted, obtained;
+    wanted.freq = sampleRate;
+    wanted.format = AUDIO_S16SYS;
+    wanted.channels = channels;
+    wanted.samples = PULL_CHUNK_SAMPLES;
+    wanted.callback = [](void *userdata, Uint8 *stream, int len)
+    {
+        static_cast<SdlAudioSink *>(userdata)->callback_(stream, len);
+    };
+    wanted.userdata = this;
+
+    // 重采样固定输出S16，不允许设备改格式，需要时由SDL内部转换
+    dev_ = SDL_OpenAudioDevice(nullptr, 0, &wanted, &obtained, 0);
+    if (dev_ == 0)
+    {
+        std::cerr << "无法打开音频设备: " << SDL_GetError() << std::endl;
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return false;
+    }
+    buffer_size_ = obtained.size;
+    return true;
+}
+
+void SdlAudioSink::Start()
+{
+    SDL_PauseAudioDevice(dev_, 0);
+}
+
+void SdlAudioSink::Close()
+{
+    if (dev_)
+    {
+        SDL_CloseAudioDevice(dev_);
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        dev_ = 0;
+    }
+}
+
+PullAudioSink::PullAudioSink(bool paced) : paced_(paced)
+{
+}
+
+PullAudioSink::~PullAudioSink()
+{
+    // 派生类析构时必须先调用Close，保证线程不会再调用已析构的Consume
+    PullAudioSink::Close();
+}
+
+bool PullAudioSink::Open(int sampleRate, int channels, Callback callback)
+{
+    sample_rate_ = sampleRate;
+    channels_ = channels;
+    chunk_bytes_ = (size_t)PULL_CHUNK_SAMPLES * channels * BYTES_PER_SAMPLE;
+    callback_ = std::move(callback);
+    return true;
+}
+
+void PullAudioSink::Start()
+{
+    if (running_.exchange(true))
+        return;
+    thread_ = std::thread([this]()
+                          { Loop(); });
+}
+
+void PullAudioSink::Close()
+{
+    running_ = false;
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void PullAudioSink::Loop()
+{
+    std::vector<uint8_t> chunk(chunk_bytes_);
+    const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>((double)PULL_CHUNK_SAMPLES / sample_rate_));
+    auto next = std::chrono::steady_clock::now();
+    while (running_)
+    {
+        if (paced_)
+        {
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+        size_t valid = callback_(chunk.data(), chunk.size());
+        Consume(chunk.data(), chunk.size(), valid);
+        // 不限速时解码跟不上就稍等，避免空转
+        if (!paced_ && valid == 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+WavAudioSink::WavAudioSink(const std::string &path, bool paced) : PullAudioSink(paced), path_(path)
+{
+}
+
+WavAudioSink::~WavAudioSink()
+{
+    Close();
+}
+
+bool WavAudioSink::Open(int sampleRate, int channels, Callback callback)
+{
+    file_.open(path_, std::ios::binary | std::ios::trunc);
+    if (!file_)
+    {
+        std::cerr << "无法创建WAV文件: " << path_ << std::endl;
+        return false;
+    }
+    PullAudioSink::Open(sampleRate, channels, std::move(callback));
+    data_bytes_ = 0;
+    // 先写占位的头，关闭时回填长度
+    WriteHeader();
+    return true;
+}
+
+void WavAudioSink::Close()
+{
+    PullAudioSink::Close();
+    if (file_.is_open())
+    {
+        file_.seekp(0);
+        WriteHeader();
+        file_.close();
+    }
+}
+
+void WavAudioSink::Consume(const uint8_t *data, size_t len, size_t valid)
+{
+    size_t n = paced_ ? len : valid;
+    file_.write((const char *)data, n);
+    data_bytes_ += (uint32_t)n;
+}
+
+// 写入一个32位或16位小端整数
+template <typename T>
+static void WriteLE(std::ofstream &out, T value)
+{
+    for (size_t i = 0; i < sizeof(T); ++i)
+        out.put((char)((value >> (8 * i)) & 0xFF));
+}
+
+void WavAudioSink::WriteHeader()
+{
+    const uint32_t byteRate = (uint32_t)sample_rate_ * channels_ * BYTES_PER_SAMPLE;
+    file_.write("RIFF", 4);
+    WriteLE<uint32_t>(file_, 36 + data_bytes_);
+    file_.write("WAVE", 4);
+    file_.write("fmt ", 4);
+    WriteLE<uint32_t>(file_, 16);
+    WriteLE<uint16_t>(file_, 1); // PCM
+    WriteLE<uint16_t>(file_, (uint16_t)channels_);
+    WriteLE<uint32_t>(file_, (uint32_t)sample_rate_);
+    WriteLE<uint32_t>(file_, byteRate);
+    WriteLE<uint16_t>(file_, (uint16_t)(channels_ * BYTES_PER_SAMPLE));
+    WriteLE<uint16_t>(file_, 16);
+    file_.write("data", 4);
+    WriteLE<uint32_t>(file_, data_bytes_);
+}
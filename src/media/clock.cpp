@@ -0,0 +1,38 @@
+#include "include/clock.h"
+#include <cmath>
+extern "C"
+{
+#include <libavutil/time.h>
+}
+
+Clock::Clock() : pts_drift_(NAN)
+{
+}
+
+double Clock::Get() const
+{
+    return pts_drift_.load(std::memory_order_acquire) + Now();
+}
+
+void Clock::Set(double pts, double time)
+{
+    pts_drift_.store(pts - time, std::memory_order_release);
+}
+
+void Clock::Set(double pts)
+{
+    Set(pts, Now());
+}
+
+void Clock::SyncTo(const Clock &slave)
+{
+    double clock = Get();
+    double slave_clock = slave.Get();
+    if (!std::isnan(slave_clock) && (std::isnan(clock) || std::fabs(clock - slave_clock) > AV_NOSYNC_THRESHOLD))
+        Set(slave_clock);
+}
+
+double Clock::Now()
+{
+    return av_gettime_relative() / 1000000.0;
+}
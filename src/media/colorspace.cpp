@@ -0,0 +1,122 @@
+#include "include/colorspace.h"
+
+extern "C"
+{
+#include <libavutil/pixdesc.h>
+}
+
+ColorDescription ColorDescription::FromFrame(const AVFrame *frame)
+{
+    ColorDescription desc;
+    desc.colorspace = frame->colorspace;
+    desc.range = frame->color_range;
+    desc.primaries = frame->color_primaries;
+    desc.format = frame->format;
+    desc.height = frame->height;
+    return desc;
+}
+
+bool ColorDescription::operator==(const ColorDescription &other) const
+{
+    return colorspace == other.colorspace && range == other.range && primaries == other.primaries &&
+           format == other.format && height == other.height;
+}
+
+// 矩阵系数未标注时的推断顺序：原色 -> 分辨率
+static AVColorSpace ResolveColorSpace(const ColorDescription &desc)
+{
+    switch (desc.colorspace)
+    {
+    case AVCOL_SPC_BT709:
+    case AVCOL_SPC_BT470BG:
+    case AVCOL_SPC_SMPTE170M:
+    case AVCOL_SPC_SMPTE240M:
+    case AVCOL_SPC_FCC:
+    case AVCOL_SPC_BT2020_NCL:
+    case AVCOL_SPC_BT2020_CL:
+        return desc.colorspace;
+    default:
+        break;
+    }
+    switch (desc.primaries)
+    {
+    case AVCOL_PRI_BT709:
+        return AVCOL_SPC_BT709;
+    case AVCOL_PRI_BT470BG:
+    case AVCOL_PRI_SMPTE170M:
+        return AVCOL_SPC_SMPTE170M;
+    case AVCOL_PRI_BT2020:
+        return AVCOL_SPC_BT2020_NCL;
+    default:
+        break;
+    }
+    return desc.height >= 720 ? AVCOL_SPC_BT709 : AVCOL_SPC_SMPTE170M;
+}
+
+// 亮度系数Kr、Kb，Kg = 1 - Kr - Kb
+static void LumaCoefficients(AVColorSpace colorspace, double *kr, double *kb)
+{
+    switch (colorspace)
+    {
+    case AVCOL_SPC_BT709:
+        *kr = 0.2126;
+        *kb = 0.0722;
+        break;
+    case AVCOL_SPC_SMPTE240M:
+        *kr = 0.212;
+        *kb = 0.087;
+        break;
+    case AVCOL_SPC_FCC:
+        *kr = 0.30;
+        *kb = 0.11;
+        break;
+    // BT.2020恒定亮度(CL)需要在线性光下解码，这里按非恒定亮度近似
+    case AVCOL_SPC_BT2020_NCL:
+    case AVCOL_SPC_BT2020_CL:
+        *kr = 0.2627;
+        *kb = 0.0593;
+        break;
+    default:
+        // BT.601 (BT470BG / SMPTE170M)
+        *kr = 0.299;
+        *kb = 0.114;
+        break;
+    }
+}
+
+ColorConversion ComputeColorConversion(const ColorDescription &desc)
+{
+    double kr, kb;
+    LumaCoefficients(ResolveColorSpace(desc), &kr, &kb);
+    const double kg = 1.0 - kr - kb;
+
+    const AVPixFmtDescriptor *pixDesc = av_pix_fmt_desc_get((AVPixelFormat)desc.format);
+    const int depth = pixDesc ? pixDesc->comp[0].depth : 8;
+    bool fullRange = desc.range == AVCOL_RANGE_JPEG;
+    if (desc.range == AVCOL_RANGE_UNSPECIFIED)
+        fullRange = desc.format == AV_PIX_FMT_YUVJ420P;
+
+    // 采样值已被归一化为 code / (2^depth - 1)
+    const double maxCode = (1 << depth) - 1;
+    const double step = 1 << (depth - 8);
+    const double chromaZero = 128 * step / maxCode;
+    double lumaOffset = 0, lumaScale = 1, chromaScale = 1;
+    if (!fullRange)
+    {
+        // limited range：亮度[16,235]，色度[16,240]，按位深等比放大
+        lumaOffset = 16 * step / maxCode;
+        lumaScale = maxCode / (219 * step);
+        chromaScale = maxCode / (224 * step);
+    }
+
+    // R = Y + 2(1-Kr)Cr
+    // G = Y - 2Kb(1-Kb)/Kg Cb - 2Kr(1-Kr)/Kg Cr
+    // B = Y + 2(1-Kb)Cb
+    // glm按列存储，matrix[c]是Y、Cb、Cr对RGB的贡献
+    ColorConversion conv;
+    conv.matrix[0] = glm::vec3(lumaScale);
+    conv.matrix[1] = glm::vec3(0.0, -2.0 * kb * (1.0 - kb) / kg, 2.0 * (1.0 - kb)) * (float)chromaScale;
+    conv.matrix[2] = glm::vec3(2.0 * (1.0 - kr), -2.0 * kr * (1.0 - kr) / kg, 0.0) * (float)chromaScale;
+    conv.offset = glm::vec3(lumaOffset, chromaZero, chromaZero);
+    return conv;
+}
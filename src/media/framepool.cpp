@@ -0,0 +1,119 @@
+#include "include/framepool.h"
+
+void FrameRecycler::operator()(AVFrame *frame) const
+{
+    if (!frame)
+        return;
+    if (pool)
+        pool->Release(frame, picture);
+    else
+        av_frame_free(&frame);
+}
+
+FramePool::FramePool(size_t capacity) : capacity_(capacity)
+{
+    // 预留空间，避免归还帧时vector扩容
+    shells_.reserve(capacity);
+    pictures_.reserve(capacity);
+}
+
+FramePool::~FramePool()
+{
+    for (auto frame : shells_)
+        av_frame_free(&frame);
+    for (auto frame : pictures_)
+        av_frame_free(&frame);
+}
+
+void FramePool::Configure(AVPixelFormat format, int width, int height)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (format == format_ && width == width_ && height == height_)
+        return;
+    format_ = format;
+    width_ = width;
+    height_ = height;
+    for (auto frame : pictures_)
+        av_frame_free(&frame);
+    pictures_.clear();
+}
+
+PooledFrame FramePool::Acquire()
+{
+    AVFrame *frame = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (outstanding_ >= capacity_)
+            return PooledFrame(nullptr, FrameRecycler{this, false});
+        if (!shells_.empty())
+        {
+            frame = shells_.back();
+            shells_.pop_back();
+        }
+        else if (!(frame = av_frame_alloc()))
+            return PooledFrame(nullptr, FrameRecycler{this, false});
+        ++outstanding_;
+    }
+    return PooledFrame(frame, FrameRecycler{this, false});
+}
+
+PooledFrame FramePool::AcquirePicture()
+{
+    AVFrame *frame = nullptr;
+    AVPixelFormat format;
+    int width, height;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (outstanding_ >= capacity_)
+            return PooledFrame(nullptr, FrameRecycler{this, true});
+        if (!pictures_.empty())
+        {
+            frame = pictures_.back();
+            pictures_.pop_back();
+        }
+        format = format_;
+        width = width_;
+        height = height_;
+        // 先占住名额，图像缓冲在锁外分配
+        ++outstanding_;
+    }
+    if (!frame)
+    {
+        // 池中没有空闲帧时才分配，之后一直循环使用
+        frame = av_frame_alloc();
+        if (frame)
+        {
+            frame->format = format;
+            frame->width = width;
+            frame->height = height;
+            if (av_frame_get_buffer(frame, 0) < 0)
+                av_frame_free(&frame);
+        }
+        if (!frame)
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            --outstanding_;
+            return PooledFrame(nullptr, FrameRecycler{this, true});
+        }
+    }
+    return PooledFrame(frame, FrameRecycler{this, true});
+}
+
+void FramePool::Release(AVFrame *frame, bool picture)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    --outstanding_;
+    if (picture)
+    {
+        // 格式或尺寸已变化的旧帧直接释放
+        if (frame->format == format_ && frame->width == width_ && frame->height == height_)
+        {
+            pictures_.push_back(frame);
+            return;
+        }
+        av_frame_free(&frame);
+        return;
+    }
+    av_frame_unref(frame);
+    shells_.push_back(frame);
+}
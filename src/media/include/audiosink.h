@@ -0,0 +1,111 @@
+#ifndef AUDIOSINK_H
+#define AUDIOSINK_H
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+#include <SDL2/SDL.h>
+
+/// @brief 音频输出，统一以16位有符号交错PCM从回调拉取数据
+/// 回调可能运行在实时线程(SDL)或输出自己的线程中，不能阻塞。
+class AudioSink
+{
+public:
+    /// @brief 填满stream的len个字节，返回其中真实数据的字节数，其余部分已由回调补静音
+    using Callback = std::function<size_t(uint8_t *stream, size_t len)>;
+
+    virtual ~AudioSink() = default;
+    /// @brief 打开输出，之后调用Start才开始拉取
+    virtual bool Open(int sampleRate, int channels, Callback callback) = 0;
+    virtual void Start() = 0;
+    /// @brief 停止并关闭输出，返回后回调不会再被调用
+    virtual void Close() = 0;
+    /// @brief 输出端自身缓冲的字节数，用来估算正在播放的位置
+    virtual int BufferSize() const = 0;
+};
+
+/// @brief 声卡输出，由SDL的音频线程按硬件节奏回调
+class SdlAudioSink : public AudioSink
+{
+public:
+    ~SdlAudioSink() override;
+    bool Open(int sampleRate, int channels, Callback callback) override;
+    void Start() override;
+    void Close() override;
+    int BufferSize() const override
+    {
+        return buffer_size_;
+    }
+
+private:
+    SDL_AudioDeviceID dev_ = 0;
+    int buffer_size_ = 0;
+    Callback callback_;
+};
+
+/// @brief 在自己的线程里按块拉取数据的输出
+/// paced为true时按数据的实际时长节奏拉取，模拟声卡；为false时尽快拉取，用于测吞吐。
+class PullAudioSink : public AudioSink
+{
+public:
+    explicit PullAudioSink(bool paced);
+    ~PullAudioSink() override;
+    bool Open(int sampleRate, int channels, Callback callback) override;
+    void Start() override;
+    void Close() override;
+    int BufferSize() const override
+    {
+        return (int)chunk_bytes_;
+    }
+
+protected:
+    /// @brief 处理拉到的一块数据，前valid个字节是真实数据，其余为静音
+    virtual void Consume(const uint8_t *data, size_t len, size_t valid)
+    {
+    }
+
+    const bool paced_;
+    int sample_rate_ = 0;
+    int channels_ = 0;
+
+private:
+    void Loop();
+
+    Callback callback_;
+    size_t chunk_bytes_ = 0;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
+
+/// @brief 丢弃所有数据，用于没有声卡的机器和测试解码、重采样吞吐
+class NullAudioSink : public PullAudioSink
+{
+public:
+    using PullAudioSink::PullAudioSink;
+};
+
+/// @brief 写入WAV文件
+/// 不限速时只写真实数据，同一输入得到相同的文件；限速时连同欠载补的静音一起写，与声卡听到的一致。
+class WavAudioSink : public PullAudioSink
+{
+public:
+    WavAudioSink(const std::string &path, bool paced);
+    ~WavAudioSink() override;
+    bool Open(int sampleRate, int channels, Callback callback) override;
+    void Close() override;
+
+protected:
+    void Consume(const uint8_t *data, size_t len, size_t valid) override;
+
+private:
+    void WriteHeader();
+
+    std::string path_;
+    std::ofstream file_;
+    uint32_t data_bytes_ = 0;
+};
+
+#endif
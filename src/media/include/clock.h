@@ -0,0 +1,46 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <atomic>
+
+// 同步阈值下限，24fps一帧的时长
+const double AV_SYNC_THRESHOLD_MIN = 0.04;
+// 同步阈值上限，约6fps一帧的时长
+const double AV_SYNC_THRESHOLD_MAX = 0.1;
+// 帧时长超过该值时，视频超前直接在原延时上加差值，而不是延时翻倍
+const double AV_SYNC_FRAMEDUP_THRESHOLD = 0.1;
+// 音视频相差超过该值时不再同步
+const double AV_NOSYNC_THRESHOLD = 10.0;
+// 相邻帧pts差值超过该值时认为是时间戳跳变，改用帧自身时长
+const double MAX_FRAME_DURATION = 10.0;
+
+/// @brief 以哪个时钟为主时钟
+enum class SyncMaster
+{
+    Audio,
+    Video,
+    External
+};
+
+/// @brief 播放时钟，参照ffplay的Clock
+/// 只保存pts与设置时刻系统时间的差值(drift)，读取时加上当前系统时间，
+/// 即"上次的pts + 上次至今流逝的时间"。drift是单个原子变量，可以在音频回调中设置、在渲染线程中读取。
+class Clock
+{
+public:
+    Clock();
+    /// @brief 当前时钟值(秒)，尚未设置过时返回NAN
+    double Get() const;
+    /// @brief 在系统时间time(秒)时，时钟走到pts
+    void Set(double pts, double time);
+    void Set(double pts);
+    /// @brief 时钟未设置或与slave相差超过AV_NOSYNC_THRESHOLD时，对齐到slave
+    void SyncTo(const Clock &slave);
+    /// @brief 单调递增的系统时间(秒)
+    static double Now();
+
+private:
+    std::atomic<double> pts_drift_;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef COLORSPACE_H
+#define COLORSPACE_H
+
+#include <glm/glm.hpp>
+extern "C"
+{
+#include <libavutil/frame.h>
+}
+
+/// @brief YUV到RGB的转换参数，片段着色器中计算 rgb = matrix * (yuv - offset)
+/// yuv是归一化到[0,1]的采样值，色彩范围(limited/full)的缩放已经合并进matrix
+struct ColorConversion
+{
+    glm::mat3 matrix;
+    glm::vec3 offset;
+};
+
+/// @brief 转换参数的来源，帧之间只在这些属性变化时才需要重新计算
+struct ColorDescription
+{
+    AVColorSpace colorspace = AVCOL_SPC_UNSPECIFIED;
+    AVColorRange range = AVCOL_RANGE_UNSPECIFIED;
+    AVColorPrimaries primaries = AVCOL_PRI_UNSPECIFIED;
+    int format = -1;
+    int height = 0;
+
+    static ColorDescription FromFrame(const AVFrame *frame);
+    bool operator==(const ColorDescription &other) const;
+    bool operator!=(const ColorDescription &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+/// @brief 根据帧的矩阵系数、色彩范围和原色计算转换参数
+/// 未标注矩阵系数时先参考原色，仍未知则按分辨率猜测(高度>=720为BT.709，否则BT.601)；
+/// 未标注色彩范围时，YUVJ格式按full处理，其余按limited处理
+ColorConversion ComputeColorConversion(const ColorDescription &desc);
+
+#endif
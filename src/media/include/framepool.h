@@ -0,0 +1,62 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <memory>
+#include <mutex>
+#include <vector>
+extern "C"
+{
+#include <libavutil/frame.h>
+}
+
+class FramePool;
+
+/// @brief PooledFrame的释放器，把帧还给所属的FramePool而不是真正释放
+struct FrameRecycler
+{
+    FramePool *pool = nullptr;
+    // 是否为自带图像缓冲的帧
+    bool picture = false;
+    void operator()(AVFrame *frame) const;
+};
+
+using PooledFrame = std::unique_ptr<AVFrame, FrameRecycler>;
+
+/// @brief 视频帧池，在解码线程和渲染线程之间循环使用AVFrame
+/// Acquire() 取出的是空帧壳，用来承接解码器输出的引用(av_frame_move_ref)，归还时只unref；
+/// AcquirePicture() 取出的帧自带按当前格式和尺寸分配好的图像缓冲，归还时缓冲保留，下次直接复用。
+/// 预热阶段之后，视频路径上不再分配帧和图像缓冲。
+/// 两种帧合计最多同时取出capacity个，达到上限时取帧返回空而不是继续分配；正常播放时在外的帧
+/// 不超过帧队列容量加上解码和渲染各持有的一帧，上限只防止归还出错时无限增长。
+/// 帧在渲染完成、PooledFrame析构时自动归还，池必须比所有取出的帧活得久。
+class FramePool
+{
+public:
+    explicit FramePool(size_t capacity);
+    ~FramePool();
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+
+    /// @brief 设置AcquirePicture的图像格式和尺寸，与之前不同时丢弃旧的缓冲
+    void Configure(AVPixelFormat format, int width, int height);
+    /// @brief 取一个空帧壳，达到上限或分配失败返回空
+    PooledFrame Acquire();
+    /// @brief 取一个带图像缓冲的帧，达到上限或分配失败返回空
+    PooledFrame AcquirePicture();
+
+private:
+    friend struct FrameRecycler;
+    void Release(AVFrame *frame, bool picture);
+
+    const size_t capacity_;
+    std::mutex mtx_;
+    // 已取出尚未归还的帧数
+    size_t outstanding_ = 0;
+    std::vector<AVFrame *> shells_;
+    std::vector<AVFrame *> pictures_;
+    AVPixelFormat format_ = AV_PIX_FMT_NONE;
+    int width_ = 0;
+    int height_ = 0;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef PBORING_H
+#define PBORING_H
+
+#include <common/gl_ext.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class PboSlot;
+
+/// @brief 像素缓冲对象(PBO)环，用于异步上传视频帧
+/// 每帧的各平面先写进PBO，再以PBO偏移为源调用glTexSubImage2D，驱动用DMA拷贝，不再在调用处同步拷贝客户端内存。
+/// 支持glBufferStorage时整块缓冲持久映射并分成若干槽位：映射地址一直有效，可以在任意线程写入，
+/// 解码线程用Acquire认领空闲槽位后直接把平面转换或拷贝进去，渲染线程只需Bind、上传、Submit；
+/// 每个槽位上传后插入栅栏，Recycle确认GPU读完后才重新变为空闲。
+/// 否则每个槽位一个PBO，由渲染线程在Map时用glBufferData孤立(orphan)旧存储再glMapBufferRange，自己拷贝平面。
+/// 除Acquire和PboSlot的析构外，所有方法都必须在GL线程调用。
+class PboRing
+{
+public:
+    explicit PboRing(int count = 3);
+    ~PboRing();
+    PboRing(const PboRing &) = delete;
+    PboRing &operator=(const PboRing &) = delete;
+
+    /// @brief 任意线程：持久映射时认领一个空闲槽位，写入后随帧交给渲染线程Bind
+    /// @param data 返回槽位的起始地址
+    /// @return 不是持久映射、没有空闲槽位或槽位容量不足时返回空；容量不足时记下size，渲染线程之后重新分配
+    PboSlot Acquire(size_t size, uint8_t **data);
+    /// @brief 把GPU已经读完的槽位重新标为空闲
+    void Recycle();
+    /// @brief 绑定Acquire得到的槽位，返回它在绑定缓冲中的起始偏移，之后调用Submit
+    size_t Bind(PboSlot &slot);
+    /// @brief 取得一个槽位的可写内存，由渲染线程自己写入，槽位容量不足时在没有槽位被占用时重新分配整个环
+    /// 返回后该槽位所在的PBO绑定在GL_PIXEL_UNPACK_BUFFER上
+    /// @return 失败时返回nullptr，调用方应直接从客户端内存上传；分配失败后一直返回nullptr
+    uint8_t *Map(size_t size);
+    /// @brief 写入结束，返回当前槽位在绑定缓冲中的起始偏移，作为glTexSubImage2D的数据指针使用
+    size_t Unmap();
+    /// @brief 上传命令已提交，为当前槽位插入栅栏，解绑PBO并前进到下一个槽位
+    void Submit();
+
+    bool persistent() const
+    {
+        return mapped_ != nullptr;
+    }
+
+private:
+    friend class PboSlot;
+
+    // 持久映射槽位的状态：RETIRED未分配或正在重新分配，FREE可认领，TAKEN已被认领，SUBMITTED已上传、等待栅栏
+    enum SlotState
+    {
+        SLOT_RETIRED,
+        SLOT_FREE,
+        SLOT_TAKEN,
+        SLOT_SUBMITTED,
+    };
+
+    int Claim();
+    /// @brief 归还一个认领后没有上传的槽位，任意线程
+    void Release(int slot);
+    /// @brief 把所有槽位标为RETIRED，有槽位正被占用时恢复原状并返回false
+    bool RetireAll();
+    bool Allocate(size_t slotSize);
+    void Destroy();
+
+    const int count_;
+    // 认领成功之后读取的字段只在所有槽位都是RETIRED时修改，由槽位状态的release/acquire发布给其他线程
+    size_t slot_size_ = 0;
+    uint8_t *mapped_ = nullptr;
+    int index_ = 0;
+    // 持久映射时只有buffers_[0]，否则每个槽位一个
+    std::vector<GLuint> buffers_;
+    std::vector<GLsync> fences_;
+    std::vector<std::atomic<int>> states_;
+    // 解码线程需要的槽位容量，超过当前容量时渲染线程重新分配
+    std::atomic<size_t> wanted_{0};
+    bool failed_ = false;
+};
+
+/// @brief 解码线程认领的持久映射槽位，随帧移动到渲染线程；没有Bind就析构(例如帧被丢弃)时归还槽位
+class PboSlot
+{
+public:
+    PboSlot() = default;
+    PboSlot(PboSlot &&other) noexcept : ring_(other.ring_), index_(other.index_)
+    {
+        other.ring_ = nullptr;
+        other.index_ = -1;
+    }
+    PboSlot &operator=(PboSlot &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            ring_ = other.ring_;
+            index_ = other.index_;
+            other.ring_ = nullptr;
+            other.index_ = -1;
+        }
+        return *this;
+    }
+    PboSlot(const PboSlot &) = delete;
+    PboSlot &operator=(const PboSlot &) = delete;
+    ~PboSlot()
+    {
+        Reset();
+    }
+
+    explicit operator bool() const
+    {
+        return index_ >= 0;
+    }
+    void Reset()
+    {
+        if (ring_ && index_ >= 0)
+            ring_->Release(index_);
+        ring_ = nullptr;
+        index_ = -1;
+    }
+
+private:
+    friend class PboRing;
+    PboSlot(PboRing *ring, int index) : ring_(ring), index_(index) {}
+
+    PboRing *ring_ = nullptr;
+    int index_ = -1;
+};
+
+#endif
@@ -4,12 +4,25 @@
 
 #include <iostream>
 #include <memory>
+#include <map>
 #include <queue>
 #include <thread>
+#include <atomic>
+#include <optional>
 #include <mutex>
 #include <condition_variable>
-#include <SDL2/SDL.h>
 #include <toolkit/bufferq.h>
+#include <toolkit/spscq.h>
+#include <toolkit/pcmring.h>
+#include "framepool.h"
+#include "clock.h"
+#include "pboring.h"
+#include "videoformat.h"
+#include "colorspace.h"
+#include "textureset.h"
+#include "audiosink.h"
+#include "telemetry.h"
+#include "trace.h"
 #include <GLFW/glfw3.h>
 #include <Program/shader.h>
 extern "C"
@@ -21,60 +34,166 @@ extern "C"
 #include <libavutil/opt.h>
 }
 
-class Clock
-{
-public:
-    double pts;
-    double time;
-    Clock(double pts, double time);
-    ~Clock();
-};
-
-class PlayState
-{
-public:
-    AVFrame *frame;
-    Clock *clk;
-    PlayState(AVFrame *frame, Clock *clk);
-    ~PlayState();
-};
-
 // 自定义智能指针释放器
 struct FFmpegDeleter
 {
     void operator()(AVFormatContext *ctx);
     void operator()(AVCodecContext *ctx);
     void operator()(AVFrame *frame);
+    void operator()(AVPacket *pkt);
     void operator()(SwsContext *ctx);
     void operator()(SwrContext *ctx);
     void operator()(GLFWwindow *window);
 };
 
+using PacketPtr = std::unique_ptr<AVPacket, FFmpegDeleter>;
+
+/// @brief 一帧待渲染的视频，以值的方式在队列中移动，帧随PlayState析构归还FramePool
+class PlayState
+{
+public:
+    PooledFrame frame;
+    // 解码线程已把平面写进持久映射的PBO槽位时有效，frame的data指向槽位内存，渲染线程只需上传
+    PboSlot pbo;
+    // 显示时间戳与帧时长，单位秒
+    double pts = 0;
+    double duration = 0;
+    // 各阶段的时间戳，随帧一起传到渲染线程
+    FrameTiming timing;
+    PlayState() = default;
+    PlayState(PooledFrame frame, double pts, double duration);
+};
+
+/// @brief 视频解码器的多线程方式
+enum class DecodeThreading
+{
+    // 由FFmpeg按解码器能力选择，帧级与片级都允许
+    Auto,
+    // 帧级多线程，吞吐最高，但解码输出会滞后约thread_count-1帧
+    Frame,
+    // 片级多线程，不增加延迟，但只对多slice编码的码流有效
+    Slice,
+};
+
+/// @brief 音频输出方式
+enum class AudioOutput
+{
+    // 声卡
+    SDL,
+    // 丢弃数据
+    Null,
+    // 写入WAV文件
+    Wav,
+};
+
+/// @brief 播放器的可选配置
+struct PlayerOptions
+{
+    // 视频解码线程数，0表示由FFmpeg按CPU核数自动决定，1表示单线程解码
+    int decoder_threads = 0;
+    DecodeThreading decoder_threading = DecodeThreading::Auto;
+    // 无窗口模式：窗口不可见，画面渲染到离屏帧缓冲，不交换缓冲也不等垂直同步
+    bool headless = false;
+    AudioOutput audio_output = AudioOutput::SDL;
+    // Null/Wav输出是否按实际时长节奏拉取数据，false时尽快拉取
+    bool audio_paced = true;
+    // Wav输出的文件路径
+    std::string audio_file = "audio.wav";
+    // 不限速：不按时钟等待显示时间，也不丢帧，帧一解出来就渲染，用于测流水线吞吐
+    bool unpaced = false;
+    // 不渲染：不创建窗口和GL上下文，解码(及格式转换)后的视频帧直接丢弃
+    bool skip_render = false;
+    // 忽略视频流，按纯音频文件播放
+    bool skip_video = false;
+    // 忽略音频流，不解码也不输出
+    bool skip_audio = false;
+    // 每隔多少秒输出一行遥测摘要，0表示不输出
+    double telemetry_interval = 5;
+    // 非空时记录各线程的活动、队列积压和时钟偏差，Stop时写成Chrome trace(JSON)，可用Perfetto打开
+    std::string trace_file;
+};
+
+/// @brief 流水线各阶段的累计耗时(秒)与计数
+/// 每个字段只由一个线程写，Stop()合并线程之后读取才完整
+struct PlayerStats
+{
+    // Play从启动线程到返回的时长
+    double play_time = 0;
+    double demux_time = 0;
+    double video_decode_time = 0;
+    double sws_time = 0;
+    double audio_decode_time = 0;
+    double resample_time = 0;
+    // 视频解码线程把解码器输出的平面拷进PBO槽位的耗时(sws转换直接写进槽位，计入sws_time)
+    double pbo_copy_time = 0;
+    // RenderFrame中PBO拷贝与纹理上传的耗时，包含在render_time内；平面已由解码线程写进槽位时只有上传
+    double upload_time = 0;
+    // 渲染与提交(交换缓冲或glFlush)的耗时
+    double render_time = 0;
+    uint64_t packets = 0;
+    uint64_t video_frames_decoded = 0;
+    // 渲染线程取出并(在不跳过渲染时)画出的帧数
+    uint64_t video_frames_presented = 0;
+    uint64_t audio_samples = 0;
+    uint64_t frame_drops_late = 0;
+    uint64_t frame_drops_early = 0;
+    uint64_t audio_underruns = 0;
+};
+
+// 渲染用的纹理组个数
+const int TEXTURE_SET_COUNT = 3;
+// 解码线程到渲染线程的帧队列容量
+const int VIDEO_FRAME_QUEUE_SIZE = 16;
+// PBO槽位数：解码线程写好的帧在队列里排队时一直占着槽位，槽位要覆盖整个队列，再加上正在写入、正在渲染和等待栅栏的几个
+const int PBO_SLOT_COUNT = VIDEO_FRAME_QUEUE_SIZE + TEXTURE_SET_COUNT;
+
 class MediaPlayer
 {
 public:
-    MediaPlayer(const std::string &filename, int videoWidth, int videoHeight);
+    MediaPlayer(const std::string &filename, int videoWidth, int videoHeight, const PlayerOptions &options = PlayerOptions());
     ~MediaPlayer();
 
     bool Init();
     void Play();
+    /// @brief 停止各线程并释放播放资源，可重复调用，只有第一次生效
     void Stop();
+    /// @brief 构造时的初始化是否成功，失败时不能调用Play
+    bool IsReady() const;
+    /// @brief 各阶段的统计，应在Stop()之后读取
+    PlayerStats Stats() const;
+    /// @brief 当前的遥测数据，播放过程中可在任意线程调用
+    TelemetrySnapshot Telemetry() const;
 
 private:
     bool OpenFile();
     bool InitVideo();
     bool InitAudio();
-    bool InitSDL();
+    bool InitAudioSink();
     bool InitGL();
-    void DecodeLoop();
+    bool InitOffscreen();
+    void DemuxLoop();
+    void VideoDecodeLoop();
+    void AudioDecodeLoop();
     void ProcessVideoPacket(AVPacket *pkt);
+    /// @brief 认领一个能放下format格式、width x height大小一帧的PBO槽位，把dst的平面指针和行宽指向槽位内存
+    PboSlot AcquirePboPlanes(AVFrame *dst, AVPixelFormat format, int width, int height);
+    bool ShouldDropEarly(double pts);
     void ProcessAudioPacket(AVPacket *pkt);
     void VideoLoop();
-    void AudioCallback(Uint8 *stream, int len);
+    void RenderFrame(PlayState &playState);
+    void LogTelemetry() const;
+    void UseVideoFormat(const VideoFormat *format);
+    void UpdateVideoSize(int width, int height);
+    size_t AudioCallback(uint8_t *stream, size_t len);
+    double GetMasterClock() const;
+    double ComputeTargetDelay(double delay) const;
 
     std::string filename_;
-    bool quit_ = false;
+    PlayerOptions options_;
+    bool ready_ = false;
+    std::atomic<bool> quit_{false};
     AVRational time_base_;
+    AVRational audio_time_base_;
 
     // FFmpeg 资源
     std::unique_ptr<AVFormatContext, FFmpegDeleter> fmt_ctx_;
@@ -82,25 +201,89 @@ private:
     std::unique_ptr<SwsContext, FFmpegDeleter> sws_ctx_;
     std::unique_ptr<SwrContext, FFmpegDeleter> swr_ctx_;
     std::unique_ptr<GLFWwindow, FFmpegDeleter> window_;
+    // 解码器输出帧，跨包复用
+    std::unique_ptr<AVFrame, FFmpegDeleter> video_frame_;
+    std::unique_ptr<AVFrame, FFmpegDeleter> audio_frame_;
 
-    PlayState *playState_ = nullptr;
+    // 时钟，有音频时以音频为主时钟，否则以外部时钟为主
+    SyncMaster sync_master_ = SyncMaster::External;
+    Clock audio_clock_;
+    Clock video_clock_;
+    Clock external_clock_;
+    // 视频流的标称帧时长，帧本身没有时长时使用
+    double video_frame_duration_ = AV_SYNC_THRESHOLD_MIN;
+    // 已写入PCM环的最后一个采样之后的pts，解码线程写，音频回调读
+    std::atomic<double> audio_write_pts_{0};
+    // audio_write_pts_与PCM环写位置的发布序号：解码线程更新两者期间为奇数，
+    // 音频回调读到前后一致的偶数才说明pts和环中字节数属于同一次写入
+    std::atomic<uint32_t> audio_write_seq_{0};
+    // 每秒PCM字节数与音频设备缓冲字节数，用来从已写入的pts反推正在播放的位置
+    int audio_bytes_per_sec_ = 0;
+    int audio_hw_buf_size_ = 0;
+    // 渲染线程的调度状态：当前帧应显示的时刻、上一帧的pts与时长
+    double frame_timer_ = 0;
+    double last_pts_ = 0;
+    double last_duration_ = 0;
+    std::atomic<uint64_t> frame_drops_late_{0};
+    // 解码线程的丢帧状态：连续落后的帧数与丢弃的帧数
+    int video_late_streak_ = 0;
+    // 帧级多线程解码带来的输出延迟(秒)，调整skip_frame后要这么久才会在输出端见效
+    double video_decode_latency_ = 0;
+    std::atomic<uint64_t> frame_drops_early_{0};
+    PlayerStats stats_;
+    // 每帧各阶段耗时的直方图，渲染线程记录
+    FrameTelemetry telemetry_;
+    // 下一次输出遥测摘要的时刻
+    double next_telemetry_ = 0;
+    TraceRecorder trace_;
 
-    // SDL 资源
-    SDL_AudioDeviceID audio_dev_ = 0;
+    // 音频输出
+    std::unique_ptr<AudioSink> audio_sink_;
+    // 各片段着色器对应的程序，键为片段着色器路径；sharder_指向当前使用的那个
+    std::map<std::string, std::unique_ptr<Shader>> media_shaders_;
     Shader *sharder_ = nullptr;
-    GLuint textures[3];
+    // 媒体着色器的uniform位置，换着色器时重新获取
+    GLint revert_loc_ = -1;
+    GLint color_matrix_loc_ = -1;
+    GLint color_offset_loc_ = -1;
+    // 当前视频帧的平面布局，决定纹理个数、格式和片段着色器
+    const VideoFormat *video_format_ = nullptr;
+    // 当前变换矩阵对应的帧尺寸
+    int frame_width_ = 0;
+    int frame_height_ = 0;
+    // 轮流使用的纹理组
+    TextureSet texture_sets_[TEXTURE_SET_COUNT];
+    int texture_set_index_ = 0;
+    // 着色器中当前颜色转换参数对应的帧属性，变化时才重新计算并上传
+    ColorDescription color_desc_;
+    // 纹理上传用的PBO环，持久映射时解码线程认领槽位写入平面，其余操作只在渲染线程；必须声明在video_frames_之前
+    PboRing pbo_ring_;
 
     int videoWidth;
     int videoHeight;
 
     GLuint vao, vbo, ebo;
+    // 无窗口模式下的离屏帧缓冲及其颜色附件
+    GLuint fbo_ = 0;
+    GLuint fbo_texture_ = 0;
 
-    // 数据队列
-    OkQueue<PlayState *> video_frames_;
-    OkQueue<std::pair<uint8_t *, size_t>> audio_data_;
-    size_t audio_pos_ = 0;
+    // 解复用线程分发给两个解码线程的压缩包队列
+    SpscQueue<PacketPtr> video_packets_;
+    SpscQueue<PacketPtr> audio_packets_;
+    // 视频帧池，必须声明在video_frames_之前，保证队列中的帧先于池析构
+    FramePool frame_pool_;
+    // 数据队列，解码线程是唯一生产者，VideoLoop/AudioCallback分别是唯一消费者
+    SpscQueue<PlayState> video_frames_;
+    // 重采样后的PCM，解码线程用swr_convert直接写入，音频回调直接读出
+    std::unique_ptr<PcmRing> audio_ring_;
+    // 一个采样帧(所有声道)的字节数
+    int audio_frame_bytes_ = 0;
     std::mutex video_mutex_;
     int video_stream_idx_ = -1, audio_stream_idx_ = -1;
+    // 解复用线程、视频解码线程、音频解码线程；音频播放在音频输出的线程，渲染在调用Play的线程
+    std::thread demux_thread_;
+    std::thread video_decode_thread_;
+    std::thread audio_decode_thread_;
 };
 
 
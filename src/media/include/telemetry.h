@@ -0,0 +1,108 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+/// @brief 一帧在流水线各处的时间戳(微秒，av_gettime_relative)，0表示该处没有经过
+struct FrameTiming
+{
+    // 解复用读出压缩包，随包的opaque经解码器带到输出帧上
+    int64_t demux = 0;
+    // 解码器输出
+    int64_t decoded = 0;
+    // 格式转换完成，可直接渲染的格式等于decoded之后立即入队的时刻
+    int64_t converted = 0;
+    // 渲染线程从帧队列取出
+    int64_t popped = 0;
+    // 纹理上传完成
+    int64_t uploaded = 0;
+    // 交换缓冲(无窗口时为glFlush)之后
+    int64_t presented = 0;
+};
+
+/// @brief 直方图的统计摘要，单位微秒
+struct HistogramSummary
+{
+    uint64_t count = 0;
+    int64_t min = 0;
+    int64_t max = 0;
+    double mean = 0;
+    int64_t p50 = 0;
+    int64_t p90 = 0;
+    int64_t p99 = 0;
+};
+
+/// @brief HDR风格的对数-线性直方图，单位微秒
+/// 每个2的幂区间再等分为SUB_BUCKETS格，任意量级下的相对误差都不超过1/SUB_BUCKETS，
+/// 固定大小、无内存分配，Record只是几次原子加法。
+/// 只允许一个线程Record，Summary可以在任意线程调用。
+class LatencyHistogram
+{
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    // 能区分的最大值为2^MAX_EXPONENT-1微秒(约19小时)，更大的值计入最后一格
+    static constexpr int MAX_EXPONENT = 36;
+    static constexpr int BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    void Record(int64_t value);
+    HistogramSummary Summary() const;
+
+private:
+    static int BucketIndex(int64_t value);
+    // 第index格能表示的最大值，百分位取这个值，偏保守
+    static int64_t BucketUpperBound(int index);
+
+    std::atomic<uint64_t> buckets_[BUCKET_COUNT] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<int64_t> sum_{0};
+    std::atomic<int64_t> min_{INT64_MAX};
+    std::atomic<int64_t> max_{0};
+};
+
+/// @brief 某一时刻的遥测数据
+struct TelemetrySnapshot
+{
+    uint64_t frames_presented = 0;
+    uint64_t frame_drops_late = 0;
+    uint64_t frame_drops_early = 0;
+    uint64_t audio_underruns = 0;
+    // 各队列当前的积压
+    size_t video_packets_queued = 0;
+    size_t audio_packets_queued = 0;
+    size_t video_frames_queued = 0;
+    size_t pcm_bytes_queued = 0;
+    // 相邻阶段之间的耗时
+    HistogramSummary decode;   // demux -> decoded
+    HistogramSummary convert;  // decoded -> converted
+    HistogramSummary queue;    // converted -> popped
+    HistogramSummary upload;   // popped -> uploaded
+    HistogramSummary present;  // uploaded -> presented
+    HistogramSummary total;    // demux -> presented
+};
+
+/// @brief 按阶段汇总每帧的FrameTiming，只在渲染线程Record
+class FrameTelemetry
+{
+public:
+    void Record(const FrameTiming &timing);
+    /// @brief 填入帧计数与各阶段直方图的摘要，其余字段由调用方填写
+    void Fill(TelemetrySnapshot &snapshot) const;
+
+private:
+    LatencyHistogram decode_;
+    LatencyHistogram convert_;
+    LatencyHistogram queue_;
+    LatencyHistogram upload_;
+    LatencyHistogram present_;
+    LatencyHistogram total_;
+    std::atomic<uint64_t> frames_{0};
+};
+
+/// @brief 输出一行摘要：计数、队列积压和各阶段的p50/p99(毫秒)
+std::ostream &operator<<(std::ostream &out, const TelemetrySnapshot &snapshot);
+
+#endif
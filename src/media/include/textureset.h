@@ -0,0 +1,35 @@
+#ifndef TEXTURESET_H
+#define TEXTURESET_H
+
+#include "videoformat.h"
+
+/// @brief 一帧视频各平面对应的一组纹理
+/// 优先用glTexStorage2D分配不可变存储，驱动不必为每次上传检查纹理是否完整、是否要重新分配；
+/// 不可变存储不能改尺寸，所以只在帧的格式或宽高变化时整组删除重建，其余时候只做glTexSubImage2D。
+/// 必须在GL线程使用。
+class TextureSet
+{
+public:
+    TextureSet() = default;
+    ~TextureSet();
+    TextureSet(const TextureSet &) = delete;
+    TextureSet &operator=(const TextureSet &) = delete;
+
+    /// @brief 保证纹理与给定的格式和尺寸一致
+    /// @return 发生了重新分配时返回true
+    bool Ensure(const VideoFormat *format, int width, int height);
+    GLuint Texture(int plane) const
+    {
+        return textures_[plane];
+    }
+
+private:
+    void Release();
+
+    const VideoFormat *format_ = nullptr;
+    int width_ = 0;
+    int height_ = 0;
+    GLuint textures_[MAX_PLANES] = {};
+};
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class TraceBuffer;
+struct TraceEvent;
+
+/// @brief 输出Chrome trace event格式(JSON)的事件记录器，可直接在Perfetto或chrome://tracing中打开
+/// 线程缓冲和事件块都在Open时一次分配好，记录线程(包括SDL的音频回调)第一次记录时用原子下标认领一个缓冲，
+/// 写满一块再认领下一块，记录路径上不加锁也不分配内存；缓冲或事件块用完后丢弃新事件并计数。
+/// Close时把所有缓冲写入文件，调用前必须确保记录线程都已停止。
+/// 未Open时所有记录函数只做一次判断就返回。
+/// 事件名只保存指针，必须是字符串字面量这类静态存储、且不含需要转义字符的字符串。
+class TraceRecorder
+{
+public:
+    TraceRecorder();
+    ~TraceRecorder();
+    TraceRecorder(const TraceRecorder &) = delete;
+    TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+    /// @brief 开始记录，事件在Close时写入path
+    bool Open(const std::string &path);
+    /// @brief 停止记录并写出文件
+    /// @return 未开启或写文件失败时返回false
+    bool Close();
+    bool Enabled() const
+    {
+        return enabled_.load(std::memory_order_acquire);
+    }
+
+    /// @brief 设置当前线程在trace中显示的名字
+    void NameThread(const char *name);
+    /// @brief 一段[start, end)的区间，时间取自Now()
+    void Complete(const char *name, int64_t start, int64_t end);
+    /// @brief 当前线程上的一个瞬时事件
+    void Instant(const char *name);
+    /// @brief 计数器的一个采样，同名计数器在trace中画成一条曲线，NAN和无穷大被忽略
+    void Counter(const char *name, double value);
+
+    /// @brief 单调递增的时间(微秒)，与av_gettime_relative一致
+    static int64_t Now();
+
+private:
+    /// @brief 当前线程的缓冲，缓冲已被认领完时返回nullptr
+    TraceBuffer *ThreadBuffer();
+    void Record(const TraceEvent &event);
+
+    // SDL的音频线程在Open之前就已存在，用release/acquire把会话号和起始时间发布给它
+    std::atomic<bool> enabled_{false};
+    std::string path_;
+    int64_t start_ = 0;
+    // 每次Open分配新的会话号，线程缓存的缓冲指针只在同一会话内有效
+    uint64_t session_ = 0;
+    // 只在Open和Close时加锁
+    std::mutex mtx_;
+    // Open时预先分配，记录线程按下标认领，Close时释放
+    std::vector<std::unique_ptr<TraceBuffer>> buffers_;
+    std::vector<std::unique_ptr<TraceEvent[]>> chunks_;
+    std::atomic<size_t> nextBuffer_{0};
+    std::atomic<size_t> nextChunk_{0};
+    // 没认领到缓冲的线程丢弃的事件数
+    std::atomic<uint64_t> dropped_{0};
+};
+
+/// @brief 作用域区间，构造时开始，析构时记录一个完整区间
+class TraceSpan
+{
+public:
+    TraceSpan(TraceRecorder &recorder, const char *name)
+        : recorder_(recorder), name_(name), start_(recorder.Enabled() ? TraceRecorder::Now() : 0)
+    {
+    }
+    ~TraceSpan()
+    {
+        if (recorder_.Enabled())
+            recorder_.Complete(name_, start_, TraceRecorder::Now());
+    }
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    TraceRecorder &recorder_;
+    const char *name_;
+    int64_t start_;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef VIDEOFORMAT_H
+#define VIDEOFORMAT_H
+
+#include <glad/glad.h>
+#include <vector>
+extern "C"
+{
+#include <libavutil/pixfmt.h>
+}
+
+// 一个格式最多的平面数
+const int MAX_PLANES = 3;
+
+/// @brief 一个平面在纹理中的布局
+struct PlaneLayout
+{
+    // 片段着色器中对应的采样器名
+    const char *sampler;
+    // 相对亮度平面的宽高下采样位数，宽高按向上取整右移
+    int widthShift;
+    int heightShift;
+    // 每个像素的字节数，用来从linesize换算GL_UNPACK_ROW_LENGTH
+    int bytesPerPixel;
+    GLint internalFormat;
+    GLenum format;
+    GLenum type;
+
+    int Width(int width) const
+    {
+        return (width + (1 << widthShift) - 1) >> widthShift;
+    }
+    int Height(int height) const
+    {
+        return (height + (1 << heightShift) - 1) >> heightShift;
+    }
+};
+
+/// @brief 可以不经sws_scale直接上传渲染的像素格式
+struct VideoFormat
+{
+    AVPixelFormat pixFmt;
+    const char *fragmentShader;
+    // 采样值乘以该系数后才是[0,1]的归一化值：高位深的样本存在16位纹理中，
+    // 低位对齐的格式(如YUV420P10LE)需要放大，高位对齐的格式(如P010)只差低位补零带来的一点偏差
+    float sampleScale;
+    int planeCount;
+    PlaneLayout planes[MAX_PLANES];
+};
+
+/// @brief 查找像素格式对应的纹理布局
+/// @return 不能直接渲染的格式返回nullptr，调用方需先转换为YUV420P
+const VideoFormat *FindVideoFormat(AVPixelFormat pixFmt);
+
+/// @brief 所有格式用到的片段着色器，去重后按表中顺序返回，用于启动时批量编译
+std::vector<const char *> VideoFragmentShaders();
+
+#endif
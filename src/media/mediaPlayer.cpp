@@ -10,25 +10,42 @@
 extern "C"
 {
 #include <libavutil/imgutils.h>
+#include <libavutil/time.h>
+#include <libavutil/pixdesc.h>
 }
+#include <cmath>
 
-// 同步阈值，在这个范围内默认同步
-// 阈值为24fps的一帧时间
-const double SYNC_THRESHOLD = 0.04;
+// 等待下一帧显示时间时单次最多休眠的时长，保证窗口事件能及时处理
+const double REFRESH_RATE = 0.01;
+// 连续落后这么多帧后，让解码器跳过非参考帧
+const int SKIP_NONREF_STREAK = 3;
+// 落后主时钟超过该值(秒)时，让解码器只解关键帧
+const double SKIP_NONKEY_LAG = 0.5;
+// 估算跳帧见效时的落后量时，解码输出延迟最多计入这么多(秒)，线程很多时不至于稍有落后就升级
+const double DECODE_LATENCY_LOOKAHEAD = 0.05;
+// 按见效时的预计落后量超过该值(秒)时，不等连续落后SKIP_NONREF_STREAK帧就跳过非参考帧
+const double SKIP_NONREF_LAG = AV_SYNC_THRESHOLD_MAX;
+// 所有媒体着色器共用的顶点着色器
+const char *MEDIA_VERTEX_SHADER = "shaders/media/media.vert";
 
-PlayState::PlayState(AVFrame *frame, Clock *clk) : frame(frame), clk(clk) {}
-
-PlayState::~PlayState()
+// 调用解码器并把耗时累加到total
+static int TimedSendPacket(AVCodecContext *ctx, const AVPacket *pkt, double &total)
 {
-    if (frame)
-        av_frame_free(&frame);
-    if (clk)
-        delete clk;
+    double start = Clock::Now();
+    int ret = avcodec_send_packet(ctx, pkt);
+    total += Clock::Now() - start;
+    return ret;
 }
 
-Clock::Clock(double pts, double time) : pts(pts), time(time) {}
+static int TimedReceiveFrame(AVCodecContext *ctx, AVFrame *frame, double &total)
+{
+    double start = Clock::Now();
+    int ret = avcodec_receive_frame(ctx, frame);
+    total += Clock::Now() - start;
+    return ret;
+}
 
-Clock::~Clock() {}
+PlayState::PlayState(PooledFrame frame, double pts, double duration) : frame(std::move(frame)), pts(pts), duration(duration) {}
 
 /// @brief 顶点及纹理坐标
 const float vertices[] = {
@@ -54,6 +71,18 @@ void FFmpegDeleter::operator()(AVCodecContext *ctx)
         avcodec_free_context(&ctx);
 }
 
+void FFmpegDeleter::operator()(AVFrame *frame)
+{
+    if (frame)
+        av_frame_free(&frame);
+}
+
+void FFmpegDeleter::operator()(AVPacket *pkt)
+{
+    if (pkt)
+        av_packet_free(&pkt);
+}
+
 void FFmpegDeleter::operator()(SwsContext *ctx)
 {
     if (ctx)
@@ -71,45 +100,139 @@ void FFmpegDeleter::operator()(GLFWwindow *window)
         glfwDestroyWindow(window);
 }
 
-MediaPlayer::MediaPlayer(const std::string &filename, int videoWidth = 800, int videoHeight = 600) : filename_(filename), audio_data_(10), video_frames_(10), videoWidth(videoWidth), videoHeight(videoHeight)
+MediaPlayer::MediaPlayer(const std::string &filename, int videoWidth = 800, int videoHeight = 600, const PlayerOptions &options) : filename_(filename), options_(options), pbo_ring_(PBO_SLOT_COUNT), videoWidth(videoWidth), videoHeight(videoHeight), video_packets_(64), audio_packets_(256), frame_pool_(32), video_frames_(VIDEO_FRAME_QUEUE_SIZE)
 {
     avformat_network_init();
-    this->Init();
+    ready_ = this->Init();
 }
 
 MediaPlayer::~MediaPlayer()
 {
     Stop();
-
-    SDL_Quit();
 }
 
 bool MediaPlayer::Init()
 {
-    if (!OpenFile() || !InitGL() || !InitVideo() || !InitAudio() || !InitSDL())
+    if (!OpenFile() || (!options_.skip_render && !InitGL()) || !InitVideo() || !InitAudio() || !InitAudioSink())
         return false;
     return true;
 }
 
+bool MediaPlayer::IsReady() const
+{
+    return ready_;
+}
+
+TelemetrySnapshot MediaPlayer::Telemetry() const
+{
+    TelemetrySnapshot snapshot;
+    telemetry_.Fill(snapshot);
+    snapshot.frame_drops_late = frame_drops_late_;
+    snapshot.frame_drops_early = frame_drops_early_;
+    snapshot.video_packets_queued = video_packets_.size();
+    snapshot.audio_packets_queued = audio_packets_.size();
+    snapshot.video_frames_queued = video_frames_.size();
+    if (audio_ring_)
+    {
+        snapshot.audio_underruns = audio_ring_->underruns();
+        snapshot.pcm_bytes_queued = audio_ring_->size();
+    }
+    return snapshot;
+}
+
+void MediaPlayer::LogTelemetry() const
+{
+    std::clog << "telemetry: " << Telemetry() << std::endl;
+}
+
+PlayerStats MediaPlayer::Stats() const
+{
+    PlayerStats stats = stats_;
+    stats.frame_drops_late = frame_drops_late_;
+    stats.frame_drops_early = frame_drops_early_;
+    if (audio_ring_)
+        stats.audio_underruns = audio_ring_->underruns();
+    return stats;
+}
+
 void MediaPlayer::Stop()
 {
+    // 基准里先显式Stop再析构，第二次调用时线程都已合并，不再重复清理和输出遥测
+    if (quit_.exchange(true))
+        return;
     std::clog << "stop" << std::endl;
-    quit_ = true;
-    if (sharder_)
+    // 关闭队列会唤醒阻塞在push/pop上的线程，解复用和解码线程随后自行退出
+    video_packets_.close();
+    audio_packets_.close();
+    video_frames_.close();
+    if (audio_ring_)
+        audio_ring_->close();
+    for (std::thread *worker : {&demux_thread_, &video_decode_thread_, &audio_decode_thread_})
+    {
+        if (worker->joinable())
+            worker->join();
+    }
+    if (audio_sink_)
+    {
+        audio_sink_->Close();
+        audio_sink_.reset();
+    }
+    LogTelemetry();
+    // 所有记录线程都已停止，可以写出trace
+    trace_.Close();
+    sharder_ = nullptr;
+    media_shaders_.clear();
+    if (fbo_)
     {
-        delete sharder_;
+        glDeleteFramebuffers(1, &fbo_);
+        glDeleteTextures(1, &fbo_texture_);
+        fbo_ = 0;
+        fbo_texture_ = 0;
     }
-    if (audio_dev_)
-        SDL_CloseAudioDevice(audio_dev_);
 }
 
 void MediaPlayer::Play()
 {
-    SDL_PauseAudioDevice(audio_dev_, 0);
-    std::thread([this]()
-                { DecodeLoop(); })
-        .detach();
+    double start = Clock::Now();
+    if (!options_.trace_file.empty())
+        trace_.Open(options_.trace_file);
+    trace_.NameThread("render");
+    if (audio_sink_)
+        audio_sink_->Start();
+    demux_thread_ = std::thread([this]()
+                                { DemuxLoop(); });
+    if (video_stream_idx_ >= 0)
+        video_decode_thread_ = std::thread([this]()
+                                           { VideoDecodeLoop(); });
+    else
+        video_frames_.close();
+    if (audio_stream_idx_ >= 0)
+        audio_decode_thread_ = std::thread([this]()
+                                           { AudioDecodeLoop(); });
     VideoLoop();
+    // 没有视频流时VideoLoop立即返回，不限速时视频也可能先于音频结束；
+    // 等音频解码完并且PCM环被取空，声音才能播完，统计也才覆盖整个文件。有窗口时继续处理窗口事件，关闭即停止
+    if (audio_decode_thread_.joinable() && (options_.unpaced || video_stream_idx_ < 0))
+    {
+        while (!quit_ && !(audio_ring_->closed() && audio_ring_->size() == 0))
+        {
+            if (window_)
+            {
+                glfwPollEvents();
+                if (glfwWindowShouldClose(window_.get()))
+                    break;
+            }
+            av_usleep(1000);
+        }
+        if (audio_ring_->closed() && audio_ring_->size() == 0)
+        {
+            audio_decode_thread_.join();
+            // 按节奏输出时设备缓冲里还有最后一段没播完
+            if (!options_.unpaced)
+                av_usleep((unsigned)(2.0 * audio_hw_buf_size_ / audio_bytes_per_sec_ * 1000000.0));
+        }
+    }
+    stats_.play_time = Clock::Now() - start;
 }
 
 bool MediaPlayer::OpenFile()
@@ -131,8 +254,8 @@ bool MediaPlayer::OpenFile()
         return false;
     }
 
-    video_stream_idx_ = av_find_best_stream(fmt_ctx_.get(), AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
-    audio_stream_idx_ = av_find_best_stream(fmt_ctx_.get(), AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+    video_stream_idx_ = options_.skip_video ? -1 : av_find_best_stream(fmt_ctx_.get(), AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    audio_stream_idx_ = options_.skip_audio ? -1 : av_find_best_stream(fmt_ctx_.get(), AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
     std::clog << "video_stream_idx_: " << video_stream_idx_ << " audio_stream_idx_: " << audio_stream_idx_ << std::endl;
     return (video_stream_idx_ >= 0 || audio_stream_idx_ >= 0);
 }
@@ -157,80 +280,100 @@ bool MediaPlayer::InitVideo()
         return false;
     }
 
+    // 让解码器把包的opaque(解复用时刻)带到输出帧上
+    video_codec_ctx_->flags |= AV_CODEC_FLAG_COPY_OPAQUE;
+    // 多线程解码，必须在avcodec_open2之前设置
+    video_codec_ctx_->thread_count = options_.decoder_threads;
+    switch (options_.decoder_threading)
+    {
+    case DecodeThreading::Frame:
+        video_codec_ctx_->thread_type = FF_THREAD_FRAME;
+        break;
+    case DecodeThreading::Slice:
+        video_codec_ctx_->thread_type = FF_THREAD_SLICE;
+        break;
+    default:
+        video_codec_ctx_->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+        break;
+    }
+
     if (avcodec_open2(video_codec_ctx_.get(), codec, nullptr) < 0)
     {
         std::cerr << "无法打开视频解码器" << std::endl;
         return false;
     }
     time_base_ = std::move(stream->time_base);
-    // 创建SwsContext
-    // SWS_BILINEAR双线性插值算法，平滑过滤
-    sws_ctx_.reset(sws_getContext(video_codec_ctx_->width, video_codec_ctx_->height, video_codec_ctx_->pix_fmt,
-                                  video_codec_ctx_->width, video_codec_ctx_->height, AV_PIX_FMT_YUV420P, SWS_BICUBIC, nullptr, nullptr, nullptr));
+    AVRational frame_rate = av_guess_frame_rate(fmt_ctx_.get(), stream, nullptr);
+    if (frame_rate.num > 0 && frame_rate.den > 0)
+        video_frame_duration_ = av_q2d(AVRational{frame_rate.den, frame_rate.num});
+    // 打开后thread_count是实际线程数，active_thread_type是实际生效的方式
+    // 帧级多线程每个线程各持有一帧，输出比输入滞后thread_count-1帧
+    if ((video_codec_ctx_->active_thread_type & FF_THREAD_FRAME) && video_codec_ctx_->thread_count > 1)
+        video_decode_latency_ = (video_codec_ctx_->thread_count - 1) * video_frame_duration_;
+    std::clog << "video decoder threads: " << video_codec_ctx_->thread_count
+              << ", frame threading: " << ((video_codec_ctx_->active_thread_type & FF_THREAD_FRAME) ? "on" : "off")
+              << ", slice threading: " << ((video_codec_ctx_->active_thread_type & FF_THREAD_SLICE) ? "on" : "off") << std::endl;
+    video_frame_.reset(av_frame_alloc());
+    if (options_.skip_render)
+        return true;
+    // 能直接渲染的格式原样上传，其余格式由解码线程逐帧转换为YUV420P
+    const VideoFormat *format = FindVideoFormat(video_codec_ctx_->pix_fmt);
+    UseVideoFormat(format ? format : FindVideoFormat(AV_PIX_FMT_YUV420P));
+    UpdateVideoSize(video_codec_ctx_->width, video_codec_ctx_->height);
+    return true;
+}
+
+void MediaPlayer::UseVideoFormat(const VideoFormat *format)
+{
+    // 片段着色器随格式而定，同一个着色器的格式之间切换只需更新归一化系数
+    if (!sharder_ || strcmp(video_format_->fragmentShader, format->fragmentShader) != 0)
+    {
+        // 正常情况下已在InitGL中批量编译好，这里只是切换程序
+        auto it = media_shaders_.find(format->fragmentShader);
+        if (it == media_shaders_.end())
+            it = media_shaders_.emplace(format->fragmentShader, std::make_unique<Shader>(MEDIA_VERTEX_SHADER, format->fragmentShader)).first;
+        sharder_ = it->second.get();
+        sharder_->use();
+        for (int i = 0; i < format->planeCount; ++i)
+            sharder_->setIntP(format->planes[i].sampler, i);
+        sharder_->setBoolP("useTexture", true);
+        revert_loc_ = sharder_->uniformLocation("revert");
+        color_matrix_loc_ = sharder_->uniformLocation("colorMatrix");
+        color_offset_loc_ = sharder_->uniformLocation("colorOffset");
+        // 新程序的uniform都是默认值，强制重新设置变换和颜色转换
+        frame_width_ = 0;
+        frame_height_ = 0;
+        color_desc_ = ColorDescription();
+    }
     sharder_->use();
-    // 创建YUV420纹理
-    glGenTextures(3, textures);
-    // Y
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, textures[0]);
-    sharder_->setIntP("textureY", 0);
-     // 设置环绕方式
-     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);     // x轴
-     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);     // y轴
-     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // 缩小
-     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // 放大
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, video_codec_ctx_->width, video_codec_ctx_->height, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
-    
-   
-    // U
-    glActiveTexture(GL_TEXTURE1);
-    glBindTexture(GL_TEXTURE_2D, textures[1]);
-    sharder_->setIntP("textureU", 1);
-    // 设置环绕方式
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);     // x轴
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);     // y轴
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // 缩小
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // 放大
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, video_codec_ctx_->width / 2, video_codec_ctx_->height / 2, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
-    
-    
-
-    // V
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, textures[2]);
-    sharder_->setIntP("textureV", 2);
-    // 设置环绕方式
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);     // x轴
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);     // y轴
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // 缩小
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // 放大
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, video_codec_ctx_->width / 2, video_codec_ctx_->height / 2, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
-   
-    
+    sharder_->setFloatP("sampleScale", format->sampleScale);
+    video_format_ = format;
+}
 
+void MediaPlayer::UpdateVideoSize(int width, int height)
+{
+    frame_width_ = width;
+    frame_height_ = height;
     // y轴翻转
     glm::mat4 revert = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f, -1.0f, 1.0f));
     if (videoWidth > videoHeight)
     {
         // 如果宽度大于高度， 则说明是横屏，我们铺满宽度，高度等比缩放
         // 首先先还原被拉伸之前的比例
-        double scale = (double)video_codec_ctx_->height / videoHeight;
-        double wScale = videoWidth / (double)video_codec_ctx_->width;
+        double scale = (double)height / videoHeight;
+        double wScale = videoWidth / (double)width;
         scale = scale * wScale;
         // 然后根据原有长宽比再次进行作坊
         revert = glm::scale(revert, glm::vec3(1.0f, scale, 1.0f));
     }
     else
     {
-        double scale = (double)video_codec_ctx_->width / videoWidth;
-        double hScale = videoHeight / (double)video_codec_ctx_->height;
+        double scale = (double)width / videoWidth;
+        double hScale = videoHeight / (double)height;
         scale = scale * hScale;
         revert = glm::scale(revert, glm::vec3(scale, 1.0f, 1.0f));
     }
-    std::string revertName = "revert";
-    sharder_->setMat4(revertName, revert);
-    sharder_->setBoolP("useTexture", true);
-    return true;
+    sharder_->setMat4(revert_loc_, revert);
 }
 
 bool MediaPlayer::InitAudio()
@@ -259,6 +402,9 @@ bool MediaPlayer::InitAudio()
         return false;
     }
 
+    audio_time_base_ = stream->time_base;
+    sync_master_ = SyncMaster::Audio;
+
     // FFmpeg 7.1 使用 AVChannelLayout
     swr_ctx_.reset(swr_alloc());
     av_opt_set_chlayout(swr_ctx_.get(), "in_chlayout", &audio_codec_ctx_->ch_layout, 0);
@@ -274,6 +420,13 @@ bool MediaPlayer::InitAudio()
         return false;
     }
 
+    // PCM环按整采样帧分配，约容纳0.5秒音频
+    audio_frame_bytes_ = audio_codec_ctx_->ch_layout.nb_channels * av_get_bytes_per_sample(AV_SAMPLE_FMT_S16);
+    size_t ring_samples = std::max(audio_codec_ctx_->sample_rate / 2, 8192);
+    audio_ring_.reset(new PcmRing(ring_samples * audio_frame_bytes_));
+    audio_bytes_per_sec_ = audio_codec_ctx_->sample_rate * audio_frame_bytes_;
+    audio_frame_.reset(av_frame_alloc());
+
     return true;
 }
 
@@ -284,14 +437,19 @@ bool MediaPlayer::InitGL()
     std::clog << "MACOS" << std::endl;
     init.type = bgfx::RendererType::Metal;
     #endif  
-    auto window = initGlEnv(videoWidth, videoHeight, "DDYPlayer");
+    auto window = initGlEnv(videoWidth, videoHeight, "DDYPlayer", !options_.headless);
     if (!window)
     {
         return false;
     }
     window_.reset(window);
-    sharder_ = new Shader("shaders/media/media.vert", "shaders/media/media.frag");
-    sharder_->use();
+    // 一次提交所有格式的着色器，驱动支持并行编译时同时编译，码流中途切换格式也不用再等编译
+    std::vector<ShaderSource> sources;
+    for (const char *fragment : VideoFragmentShaders())
+        sources.push_back({MEDIA_VERTEX_SHADER, fragment});
+    std::vector<std::unique_ptr<Shader>> shaders = Shader::createBatch(sources);
+    for (size_t i = 0; i < sources.size(); ++i)
+        media_shaders_[sources[i].fragmentPath] = std::move(shaders[i]);
     glGenVertexArrays(1, &vao);
     glBindVertexArray(vao);
     glGenBuffers(1, &vbo);
@@ -305,7 +463,15 @@ bool MediaPlayer::InitGL()
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
 
-    glfwSwapInterval(1);
+    if (options_.headless)
+    {
+        if (!InitOffscreen())
+            return false;
+    }
+    else
+    {
+        glfwSwapInterval(1);
+    }
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
     glBindVertexArray(0);
@@ -315,57 +481,84 @@ bool MediaPlayer::InitGL()
     return true;
 }
 
-bool MediaPlayer::InitSDL()
+bool MediaPlayer::InitOffscreen()
 {
-    if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_TIMER) < 0)
+    // 颜色附件与窗口同尺寸，之后所有绘制都落在这里，不再依赖默认帧缓冲
+    glGenTextures(1, &fbo_texture_);
+    glBindTexture(GL_TEXTURE_2D, fbo_texture_);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, videoWidth, videoHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &fbo_);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fbo_texture_, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
     {
-        std::cerr << "SDL初始化失败: " << SDL_GetError() << std::endl;
+        std::cerr << "离屏帧缓冲不完整" << std::endl;
         return false;
     }
+    glViewport(0, 0, videoWidth, videoHeight);
+    // 不可见窗口不交换缓冲，关闭垂直同步以免驱动仍按刷新率节流
+    glfwSwapInterval(0);
+    return true;
+}
 
-    if (audio_stream_idx_ >= 0)
-    {
-        SDL_AudioSpec wanted, obtained;
-        wanted.freq = audio_codec_ctx_->sample_rate;
-        wanted.format = AUDIO_S16SYS;
-        wanted.channels = audio_codec_ctx_->ch_layout.nb_channels;
-        wanted.samples = 1024;
-        wanted.callback = [](void *userdata, Uint8 *stream, int len)
-        {
-            static_cast<MediaPlayer *>(userdata)->AudioCallback(stream, len);
-        };
-        wanted.userdata = this;
+bool MediaPlayer::InitAudioSink()
+{
+    if (audio_stream_idx_ < 0)
+        return true;
 
-        audio_dev_ = SDL_OpenAudioDevice(nullptr, 0, &wanted, &obtained, SDL_AUDIO_ALLOW_FORMAT_CHANGE);
-        if (audio_dev_ == 0)
-        {
-            std::cerr << "无法打开音频设备: " << SDL_GetError() << std::endl;
-            return false;
-        }
+    switch (options_.audio_output)
+    {
+    case AudioOutput::Null:
+        audio_sink_ = std::make_unique<NullAudioSink>(options_.audio_paced);
+        break;
+    case AudioOutput::Wav:
+        audio_sink_ = std::make_unique<WavAudioSink>(options_.audio_file, options_.audio_paced);
+        break;
+    default:
+        audio_sink_ = std::make_unique<SdlAudioSink>();
+        break;
     }
-
+    if (!audio_sink_->Open(audio_codec_ctx_->sample_rate, audio_codec_ctx_->ch_layout.nb_channels, [this](uint8_t *stream, size_t len)
+                           { return AudioCallback(stream, len); }))
+    {
+        audio_sink_.reset();
+        return false;
+    }
+    audio_hw_buf_size_ = audio_sink_->BufferSize();
     return true;
 }
 
-void MediaPlayer::DecodeLoop()
+void MediaPlayer::DemuxLoop()
 {
-    AVPacket pkt;
+    trace_.NameThread("demux");
     int readRes = -1;
-    while (!quit_ && (readRes = av_read_frame(fmt_ctx_.get(), &pkt)) >= 0)
+    while (!quit_)
     {
-
-        if (pkt.stream_index == audio_stream_idx_)
-        {
-            ProcessAudioPacket(&pkt);
-        }else  if (pkt.stream_index == video_stream_idx_)
-        {
-            ProcessVideoPacket(&pkt);
-        }
-        av_packet_unref(&pkt);
+        PacketPtr pkt(av_packet_alloc());
+        int64_t start = av_gettime_relative();
+        readRes = av_read_frame(fmt_ctx_.get(), pkt.get());
+        int64_t end = av_gettime_relative();
+        stats_.demux_time += (end - start) / 1000000.0;
+        trace_.Complete("av_read_frame", start, end);
+        if (readRes < 0)
+            break;
+        ++stats_.packets;
+        pkt->opaque = (void *)(intptr_t)end;
+        // 按流分发，队列满时阻塞，队列关闭时push失败包随之释放
+        if (pkt->stream_index == audio_stream_idx_)
+            audio_packets_.push(std::move(pkt));
+        else if (pkt->stream_index == video_stream_idx_)
+            video_packets_.push(std::move(pkt));
     }
+    // 文件读完后关闭包队列，解码线程取完剩余的包后冲刷解码器并退出
+    video_packets_.close();
+    audio_packets_.close();
 
-    // quit_ = true;
-    if (readRes < 0)
+    if (readRes < 0 && readRes != AVERROR_EOF)
     {
         char errbuf[AV_ERROR_MAX_STRING_SIZE];
         av_strerror(readRes, errbuf, sizeof(errbuf));
@@ -373,126 +566,488 @@ void MediaPlayer::DecodeLoop()
     }
 }
 
+void MediaPlayer::VideoDecodeLoop()
+{
+    trace_.NameThread("video decode");
+    while (auto pkt = video_packets_.pop())
+    {
+        if (quit_)
+            break;
+        ProcessVideoPacket(pkt->get());
+    }
+    // 送入空包取出解码器中缓存的帧
+    if (!quit_)
+        ProcessVideoPacket(nullptr);
+    // 消费者取完剩余帧即退出
+    video_frames_.close();
+}
+
+void MediaPlayer::AudioDecodeLoop()
+{
+    trace_.NameThread("audio decode");
+    while (auto pkt = audio_packets_.pop())
+    {
+        if (quit_)
+            break;
+        ProcessAudioPacket(pkt->get());
+    }
+    if (!quit_)
+        ProcessAudioPacket(nullptr);
+    audio_ring_->close();
+}
+
 void MediaPlayer::ProcessVideoPacket(AVPacket *pkt)
 {
-    if (avcodec_send_packet(video_codec_ctx_.get(), pkt) != 0)
+    TraceSpan span(trace_, "video packet");
+    if (TimedSendPacket(video_codec_ctx_.get(), pkt, stats_.video_decode_time) != 0)
         return;
-    AVFrame *frame = av_frame_alloc();
-    while (avcodec_receive_frame(video_codec_ctx_.get(), frame) == 0)
+    AVFrame *frame = video_frame_.get();
+    while (TimedReceiveFrame(video_codec_ctx_.get(), frame, stats_.video_decode_time) == 0)
     {
-        std::clog << "receive frame, pts" << frame->pts << std::endl;
-        double now = glfwGetTime();
-        if (playState_)
+        ++stats_.video_frames_decoded;
+        FrameTiming timing;
+        timing.demux = (int64_t)(intptr_t)frame->opaque;
+        timing.decoded = av_gettime_relative();
+        double pts = frame->pts == AV_NOPTS_VALUE ? NAN : frame->pts * av_q2d(time_base_);
+        double duration = frame->duration > 0 ? frame->duration * av_q2d(time_base_) : video_frame_duration_;
+        // 已经落后于主时钟的帧在转换和入队之前就丢弃
+        if (ShouldDropEarly(pts))
+        {
+            av_frame_unref(frame);
+            continue;
+        }
+        PooledFrame pFrameYUV;
+        PboSlot slot;
+        if (FindVideoFormat((AVPixelFormat)frame->format))
         {
-            double pts = frame->pts * av_q2d(time_base_);
-            double lasTime = playState_->clk->time;
-            double playTime = lasTime + pts;
-            double diff = playTime - now;
-            // 如果错过帧播放时机，直接丢弃
-            if (diff < 0)
+            pFrameYUV = frame_pool_.Acquire();
+            if (!pFrameYUV)
             {
+                av_frame_unref(frame);
                 continue;
             }
+            // 解码器输出可以直接渲染：有空闲的PBO槽位时在本线程把平面拷进去，渲染线程只需发起上传；
+            // 否则把引用计数的帧转交给渲染队列，由渲染线程拷贝
+            slot = AcquirePboPlanes(pFrameYUV.get(), (AVPixelFormat)frame->format, frame->width, frame->height);
+            if (slot)
+            {
+                TraceSpan copySpan(trace_, "copy to pbo");
+                double start = Clock::Now();
+                av_image_copy(pFrameYUV->data, pFrameYUV->linesize, (const uint8_t **)frame->data, frame->linesize,
+                              (AVPixelFormat)frame->format, frame->width, frame->height);
+                stats_.pbo_copy_time += Clock::Now() - start;
+                av_frame_copy_props(pFrameYUV.get(), frame);
+                av_frame_unref(frame);
+            }
+            else
+                av_frame_move_ref(pFrameYUV.get(), frame);
         }
+        else
+        {
+            TraceSpan convertSpan(trace_, "sws_scale");
+            double start = Clock::Now();
+            // 按帧的实际格式和尺寸取转换上下文，码流中途改变分辨率时才会重建
+            sws_ctx_.reset(sws_getCachedContext(sws_ctx_.release(), frame->width, frame->height, (AVPixelFormat)frame->format,
+                                                frame->width, frame->height, AV_PIX_FMT_YUV420P, SWS_BICUBIC, nullptr, nullptr, nullptr));
+            frame_pool_.Configure(AV_PIX_FMT_YUV420P, frame->width, frame->height);
+            // 有空闲的PBO槽位时直接转换进槽位，否则转换到帧池的图像缓冲，图像缓冲在渲染完成后归还复用
+            if (sws_ctx_)
+            {
+                pFrameYUV = frame_pool_.Acquire();
+                if (pFrameYUV && !(slot = AcquirePboPlanes(pFrameYUV.get(), AV_PIX_FMT_YUV420P, frame->width, frame->height)))
+                    pFrameYUV = frame_pool_.AcquirePicture();
+            }
+            if (!pFrameYUV)
+            {
+                av_frame_unref(frame);
+                continue;
+            }
+            sws_scale(sws_ctx_.get(), (const uint8_t *const *)frame->data, frame->linesize, 0, frame->height, pFrameYUV->data, pFrameYUV->linesize);
+            stats_.sws_time += Clock::Now() - start;
+            // 带上源帧的色彩属性；sws输出是limited range，RGB源按默认的BT.601矩阵转成YUV
+            av_frame_copy_props(pFrameYUV.get(), frame);
+            pFrameYUV->color_range = AVCOL_RANGE_MPEG;
+            if (pFrameYUV->colorspace == AVCOL_SPC_RGB)
+                pFrameYUV->colorspace = AVCOL_SPC_SMPTE170M;
+            av_frame_unref(frame);
+        }
+        timing.converted = av_gettime_relative();
+        PlayState state(std::move(pFrameYUV), pts, duration);
+        state.pbo = std::move(slot);
+        state.timing = timing;
+        bool pushed;
+        {
+            TraceSpan pushSpan(trace_, "wait frame queue");
+            pushed = video_frames_.push(std::move(state));
+        }
+        if (!pushed)
+            break;
+    }
+}
 
-        AVFrame *pFrameYUV = av_frame_alloc();
-        pFrameYUV->format = AV_PIX_FMT_YUV420P;
-        uint8_t *out_buffer = (uint8_t *)av_malloc(av_image_get_buffer_size(AV_PIX_FMT_YUV420P, video_codec_ctx_.get()->width, video_codec_ctx_.get()->height, 1));
-        av_image_fill_arrays(pFrameYUV->data, pFrameYUV->linesize, out_buffer, AV_PIX_FMT_YUV420P, video_codec_ctx_.get()->width, video_codec_ctx_.get()->height, 1);
-        // 释放out_buffer
-        av_free(out_buffer);
+PboSlot MediaPlayer::AcquirePboPlanes(AVFrame *dst, AVPixelFormat format, int width, int height)
+{
+    // 行宽按64字节对齐，满足GL_UNPACK_ROW_LENGTH按像素计和各平面起始偏移的对齐要求
+    const int align = 64;
+    int size = av_image_get_buffer_size(format, width, height, align);
+    uint8_t *data = nullptr;
+    PboSlot slot = size > 0 ? pbo_ring_.Acquire((size_t)size, &data) : PboSlot();
+    if (!slot)
+        return slot;
+    av_image_fill_arrays(dst->data, dst->linesize, data, format, width, height, align);
+    dst->format = format;
+    dst->width = width;
+    dst->height = height;
+    return slot;
+}
 
-        sws_scale(sws_ctx_.get(), (const uint8_t *const *)frame->data, frame->linesize, 0, video_codec_ctx_.get()->height, pFrameYUV->data, pFrameYUV->linesize);
-        PlayState *playState = new PlayState(pFrameYUV, new Clock(frame->pts * av_q2d(time_base_), now));
-        playState_ = playState;
-        video_frames_.push(playState);
+bool MediaPlayer::ShouldDropEarly(double pts)
+{
+    if (options_.unpaced || sync_master_ == SyncMaster::Video || std::isnan(pts))
+        return false;
+    double diff = pts - GetMasterClock();
+    if (std::isnan(diff) || std::fabs(diff) >= AV_NOSYNC_THRESHOLD)
+        return false;
+    if (diff >= 0)
+    {
+        // 已经追上，恢复正常解码
+        video_late_streak_ = 0;
+        if (video_codec_ctx_->skip_frame != AVDISCARD_DEFAULT)
+            video_codec_ctx_->skip_frame = AVDISCARD_DEFAULT;
+        return false;
     }
-    av_frame_free(&frame);
+    // 仍然落后，逐级让解码器少解一些帧：先跳过非参考帧，实际落后太多时才只解关键帧
+    ++video_late_streak_;
+    ++frame_drops_early_;
+    trace_.Instant("early drop");
+    // 帧级多线程时解码器里还压着若干帧，新的skip_frame要等它们输出后才见效；
+    // 这部分延迟只用来提前跳过非参考帧，而且封顶，只解关键帧仍以实测的落后量为准
+    double expected_lag = std::min(video_decode_latency_, DECODE_LATENCY_LOOKAHEAD) - diff;
+    if (-diff > SKIP_NONKEY_LAG)
+        video_codec_ctx_->skip_frame = AVDISCARD_NONKEY;
+    else if ((video_late_streak_ >= SKIP_NONREF_STREAK || expected_lag > SKIP_NONREF_LAG) &&
+             video_codec_ctx_->skip_frame < AVDISCARD_NONREF)
+        video_codec_ctx_->skip_frame = AVDISCARD_NONREF;
+    return true;
 }
 
 void MediaPlayer::ProcessAudioPacket(AVPacket *pkt)
 {
-    if (avcodec_send_packet(audio_codec_ctx_.get(), pkt) != 0)
+    TraceSpan span(trace_, "audio packet");
+    if (TimedSendPacket(audio_codec_ctx_.get(), pkt, stats_.audio_decode_time) != 0)
         return;
-    AVFrame *frame = av_frame_alloc();
-    while (avcodec_receive_frame(audio_codec_ctx_.get(), frame) == 0)
+    AVFrame *frame = audio_frame_.get();
+    while (TimedReceiveFrame(audio_codec_ctx_.get(), frame, stats_.audio_decode_time) == 0)
     {
-        uint8_t *output;
         int out_samples = swr_get_out_samples(swr_ctx_.get(), frame->nb_samples);
-        av_samples_alloc(&output, nullptr, audio_codec_ctx_->ch_layout.nb_channels,
-                         out_samples, AV_SAMPLE_FMT_S16, 0);
-        out_samples = swr_convert(swr_ctx_.get(), &output, out_samples,
-                                  (const uint8_t **)frame->data, frame->nb_samples);
+        bool writable;
+        {
+            TraceSpan waitSpan(trace_, "wait pcm ring");
+            writable = audio_ring_->wait_writable(out_samples * audio_frame_bytes_);
+        }
+        if (!writable)
+        {
+            av_frame_unref(frame);
+            return;
+        }
+        // 直接转换进环里的空闲区域；第一段写满后剩余采样留在SwrContext中，再用空输入写进第二段
+        uint8_t *spans[2];
+        size_t lens[2];
+        audio_ring_->reserve(&spans[0], &lens[0], &spans[1], &lens[1]);
+        const uint8_t **input = (const uint8_t **)frame->data;
+        int in_samples = frame->nb_samples;
+        size_t written = 0;
+        int64_t start = av_gettime_relative();
+        for (int i = 0; i < 2 && lens[i] > 0; ++i)
+        {
+            int capacity = lens[i] / audio_frame_bytes_;
+            int converted = swr_convert(swr_ctx_.get(), &spans[i], capacity, input, in_samples);
+            input = nullptr;
+            in_samples = 0;
+            if (converted <= 0)
+                break;
+            written += converted * audio_frame_bytes_;
+            if (converted < capacity)
+                break;
+        }
+        int64_t end = av_gettime_relative();
+        stats_.resample_time += (end - start) / 1000000.0;
+        trace_.Complete("swr_convert", start, end);
+        stats_.audio_samples += written / audio_frame_bytes_;
+        // 写入末尾对应的pts与新数据一起发布，供音频回调推算时钟；没有pts的帧接着上一帧往后算
+        double pts = frame->pts == AV_NOPTS_VALUE ? audio_write_pts_.load(std::memory_order_relaxed)
+                                                  : frame->pts * av_q2d(audio_time_base_);
+        audio_write_seq_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        audio_write_pts_.store(pts + (double)written / audio_bytes_per_sec_, std::memory_order_relaxed);
+        audio_ring_->commit(written);
+        audio_write_seq_.fetch_add(1, std::memory_order_release);
+        av_frame_unref(frame);
+    }
+}
 
-        std::pair<uint8_t *, size_t> data(output, out_samples * audio_codec_ctx_->ch_layout.nb_channels * 2);
-        audio_data_.push(std::move(data));
+double MediaPlayer::GetMasterClock() const
+{
+    switch (sync_master_)
+    {
+    case SyncMaster::Audio:
+        return audio_clock_.Get();
+    case SyncMaster::Video:
+        return video_clock_.Get();
+    default:
+        return external_clock_.Get();
     }
-    av_frame_free(&frame);
+}
+
+double MediaPlayer::ComputeTargetDelay(double delay) const
+{
+    // 参照ffplay的compute_target_delay，详见ff-design.md
+    if (sync_master_ == SyncMaster::Video)
+        return delay;
+    // 视频时钟 - 主时钟，> 0 视频超前，< 0 视频落后
+    double diff = video_clock_.Get() - GetMasterClock();
+    double sync_threshold = std::max(AV_SYNC_THRESHOLD_MIN, std::min(AV_SYNC_THRESHOLD_MAX, delay));
+    if (!std::isnan(diff) && std::fabs(diff) < AV_NOSYNC_THRESHOLD)
+    {
+        if (diff <= -sync_threshold)
+            delay = std::max(0.0, delay + diff);
+        else if (diff >= sync_threshold && delay > AV_SYNC_FRAMEDUP_THRESHOLD)
+            delay = delay + diff;
+        else if (diff >= sync_threshold)
+            delay = 2 * delay;
+    }
+    return delay;
 }
 
 void MediaPlayer::VideoLoop()
 {
-    while (!quit_ && glfwWindowShouldClose(window_.get()) == 0)
+    std::optional<PlayState> current;
+    bool first = true;
+    while (!quit_ && (!window_ || glfwWindowShouldClose(window_.get()) == 0))
     {
-        auto playState = video_frames_.pop();
-        // 渲染
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        sharder_->use();
-        // 更新纹理
-        // Y
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textures[0]);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, video_codec_ctx_->width, video_codec_ctx_->height, GL_RED, GL_UNSIGNED_BYTE, playState->frame->data[0]);
-        int error = glGetError();
-        if (error != GL_NO_ERROR)
+        if (!current)
         {
-            std::cout << "update texture Y error" << error << std::endl;
+            current = video_frames_.pop();
+            if (!current)
+                break;
+            current->timing.popped = av_gettime_relative();
+            trace_.Counter("video packets queued", video_packets_.size());
+            trace_.Counter("audio packets queued", audio_packets_.size());
+            trace_.Counter("video frames queued", video_frames_.size());
         }
-        // U
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, textures[1]);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, video_codec_ctx_->width / 2, video_codec_ctx_->height / 2, GL_RED, GL_UNSIGNED_BYTE, playState->frame->data[1]);
-         error = glGetError();
-        if (error != GL_NO_ERROR)
+        double time = Clock::Now();
+        if (first)
         {
-            std::cout << "update texture U error" << error << std::endl;
+            frame_timer_ = time;
+            next_telemetry_ = time + options_.telemetry_interval;
+            last_pts_ = current->pts;
+            last_duration_ = current->duration;
+            first = false;
         }
-        // V
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, textures[2]);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, video_codec_ctx_->width / 2, video_codec_ctx_->height / 2, GL_RED, GL_UNSIGNED_BYTE, playState->frame->data[2]);
-        error = glGetError();
-        if (error != GL_NO_ERROR)
+
+        // 上一帧应持续的时长，pts跳变时退回帧自身时长
+        double last_duration = current->pts - last_pts_;
+        if (std::isnan(last_duration) || last_duration <= 0 || last_duration > MAX_FRAME_DURATION)
+            last_duration = last_duration_;
+        double delay = ComputeTargetDelay(last_duration);
+
+        // 还没到显示时间，先休眠，期间继续处理窗口事件
+        if (!options_.unpaced && time < frame_timer_ + delay)
+        {
+            av_usleep((unsigned)(std::min(frame_timer_ + delay - time, REFRESH_RATE) * 1000000.0));
+            glfwPollEvents();
+            continue;
+        }
+        frame_timer_ += delay;
+        if (delay > 0 && time - frame_timer_ > AV_SYNC_THRESHOLD_MAX)
+            frame_timer_ = time;
+
+        if (!std::isnan(current->pts))
         {
-            std::cout << "update texture V error" << error << std::endl;
+            video_clock_.Set(current->pts);
+            external_clock_.SyncTo(video_clock_);
+        }
+        trace_.Counter("frame delay ms", delay * 1000);
+        trace_.Counter("video - master ms", (video_clock_.Get() - GetMasterClock()) * 1000);
+        last_pts_ = current->pts;
+        last_duration_ = current->duration;
+
+        // 已经错过了这一帧的显示时段，并且后面还有帧，直接丢弃
+        if (!options_.unpaced && !video_frames_.empty() && time > frame_timer_ + current->duration)
+        {
+            ++frame_drops_late_;
+            trace_.Instant("late drop");
+            current.reset();
+            continue;
+        }
+
+        if (!options_.skip_render)
+        {
+            double start = Clock::Now();
+            {
+                TraceSpan renderSpan(trace_, "render frame");
+                RenderFrame(*current);
+            }
+            {
+                TraceSpan swapSpan(trace_, "swap");
+                // 离屏渲染没有可交换的缓冲，只把命令提交给驱动
+                if (options_.headless)
+                    glFlush();
+                else
+                    glfwSwapBuffers(window_.get());
+            }
+            stats_.render_time += Clock::Now() - start;
+            current->timing.presented = av_gettime_relative();
+            glfwPollEvents();
+        }
+        ++stats_.video_frames_presented;
+        telemetry_.Record(current->timing);
+        current.reset();
+        if (options_.telemetry_interval > 0 && time >= next_telemetry_)
+        {
+            next_telemetry_ = time + options_.telemetry_interval;
+            LogTelemetry();
         }
-        glBindVertexArray(vao);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        // glBindVertexArray(0);
-        // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-        glfwSwapBuffers(window_.get());
-        glfwPollEvents();
     }
 }
 
-void MediaPlayer::AudioCallback(Uint8 *stream, int len)
+void MediaPlayer::RenderFrame(PlayState &playState)
 {
-    // if (audio_data_.empty())
-    // {
-    //     memset(stream, 0, len);
-    //     return;
-    // }
-
-    auto &data = audio_data_.pop();
-    int copy_size = std::min(len, static_cast<int>(data.second - audio_pos_));
-    memcpy(stream, data.first + audio_pos_, copy_size);
-    audio_pos_ += copy_size;
+    // 渲染
+    glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    const AVFrame *frame = playState.frame.get();
+    // 解码线程保证入队的帧都能直接渲染，格式或分辨率在码流中途变化时切换着色器和变换
+    const VideoFormat *format = FindVideoFormat((AVPixelFormat)frame->format);
+    if (!format)
+        return;
+    if (format != video_format_)
+        UseVideoFormat(format);
+    if (frame->width != frame_width_ || frame->height != frame_height_)
+        UpdateVideoSize(frame->width, frame->height);
+    sharder_->use();
+    // 颜色转换全部在着色器里完成，帧的矩阵系数或色彩范围变化时才更新uniform
+    ColorDescription colorDesc = ColorDescription::FromFrame(frame);
+    if (colorDesc != color_desc_)
+    {
+        color_desc_ = colorDesc;
+        ColorConversion conv = ComputeColorConversion(colorDesc);
+        sharder_->setMat3(color_matrix_loc_, conv.matrix);
+        sharder_->setVec3(color_offset_loc_, conv.offset);
+        std::clog << "color space: " << av_color_space_name(colorDesc.colorspace)
+                  << ", range: " << av_color_range_name(colorDesc.range) << std::endl;
+    }
+    // 更新纹理，解码器输出的行宽带有对齐填充，用GL_UNPACK_ROW_LENGTH按linesize读取
+    // 纹理组轮流使用，上传下一帧时不必等待上一帧的绘制读完同一组纹理
+    TextureSet &textures = texture_sets_[texture_set_index_];
+    texture_set_index_ = (texture_set_index_ + 1) % TEXTURE_SET_COUNT;
+    textures.Ensure(format, frame->width, frame->height);
+    const int planeCount = format->planeCount;
+    int64_t uploadStart = av_gettime_relative();
+    // 纹理从PBO上传，glTexSubImage2D不用等待客户端内存拷贝
+    const void *sources[MAX_PLANES];
+    size_t planeSizes[MAX_PLANES];
+    size_t total = 0;
+    bool usePbo = true;
+    for (int i = 0; i < planeCount; ++i)
+    {
+        sources[i] = frame->data[i];
+        usePbo = usePbo && frame->linesize[i] > 0;
+        planeSizes[i] = (size_t)frame->linesize[i] * format->planes[i].Height(frame->height);
+        total += planeSizes[i];
+    }
+    // GPU已经读完的槽位还给解码线程
+    pbo_ring_.Recycle();
+    uint8_t *staging = nullptr;
+    bool staged = false;
+    if (playState.pbo)
+    {
+        // 解码线程已经把各平面写进持久映射的槽位，这里只绑定并发起上传
+        size_t base = pbo_ring_.Bind(playState.pbo);
+        for (int i = 0; i < planeCount; ++i)
+            sources[i] = reinterpret_cast<const void *>(base + (frame->data[i] - frame->data[0]));
+        staged = true;
+    }
+    else if (usePbo && (staging = pbo_ring_.Map(total)))
+    {
+        // 先把各平面按linesize原样拷进PBO
+        staged = true;
+        size_t offset = 0;
+        for (int i = 0; i < planeCount; ++i)
+        {
+            memcpy(staging + offset, frame->data[i], planeSizes[i]);
+            offset += planeSizes[i];
+        }
+        // 绑定了GL_PIXEL_UNPACK_BUFFER时，数据指针表示缓冲内的偏移
+        size_t base = pbo_ring_.Unmap();
+        for (int i = 0; i < planeCount; ++i)
+        {
+            sources[i] = reinterpret_cast<const void *>(base);
+            base += planeSizes[i];
+        }
+    }
+    for (int i = 0; i < planeCount; ++i)
+    {
+        const PlaneLayout &plane = format->planes[i];
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, textures.Texture(i));
+        // GL_UNPACK_ROW_LENGTH以像素为单位，双通道平面每像素占两个字节
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[i] / plane.bytesPerPixel);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, plane.Width(frame->width), plane.Height(frame->height),
+                        plane.format, plane.type, sources[i]);
+        int error = glGetError();
+        if (error != GL_NO_ERROR)
+        {
+            std::cout << "update texture " << plane.sampler << " error" << error << std::endl;
+        }
+    }
+    if (staged)
+        pbo_ring_.Submit();
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    playState.timing.uploaded = av_gettime_relative();
+    stats_.upload_time += (playState.timing.uploaded - uploadStart) / 1000000.0;
+    trace_.Complete("upload", uploadStart, playState.timing.uploaded);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    // glBindVertexArray(0);
+    // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
 
-    if (audio_pos_ >= data.second)
+size_t MediaPlayer::AudioCallback(uint8_t *stream, size_t len)
+{
+    // 音频回调运行在音频输出的线程(SDL时为实时线程)，不能阻塞等待解码线程；
+    // 从PCM环中一次读满len，读不满时对缺的部分补静音
+    trace_.NameThread("audio output");
+    TraceSpan span(trace_, "audio callback");
+    double callback_time = Clock::Now();
+    bool underrun = false;
+    size_t read = audio_ring_->read(stream, len, &underrun);
+    if (read < len)
+        memset(stream + read, 0, len - read);
+    if (underrun)
+        trace_.Instant("underrun");
+    // 正在播放的位置 = 已写入末尾的pts - 环中和设备缓冲中尚未播放的数据时长；
+    // pts和环中字节数要取自同一次写入，解码线程正在更新时重读，几次都碰上(例如它恰好被抢占)就这次不校正时钟
+    double pts = 0;
+    size_t queued = 0;
+    bool consistent = false;
+    for (int attempt = 0; attempt < 3 && !consistent; ++attempt)
     {
-        av_freep(&data.first);
-        audio_pos_ = 0;
+        uint32_t seq = audio_write_seq_.load(std::memory_order_acquire);
+        pts = audio_write_pts_.load(std::memory_order_relaxed);
+        queued = audio_ring_->size();
+        std::atomic_thread_fence(std::memory_order_acquire);
+        consistent = (seq & 1) == 0 && seq == audio_write_seq_.load(std::memory_order_relaxed);
     }
-}
\ No newline at end of file
+    trace_.Counter("pcm bytes queued", queued);
+    double buffered = (double)(queued + 2 * audio_hw_buf_size_) / audio_bytes_per_sec_;
+    if (read > 0 && consistent)
+    {
+        // 新的时钟值与按旧值推算的差，即这次回调校正掉的漂移
+        trace_.Counter("audio clock drift ms", (pts - buffered - audio_clock_.Get()) * 1000);
+        audio_clock_.Set(pts - buffered, callback_time);
+        external_clock_.SyncTo(audio_clock_);
+    }
+    return read;
+}
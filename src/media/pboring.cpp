@@ -0,0 +1,271 @@
+#include "include/pboring.h"
+
+#include <algorithm>
+#include <iostream>
+
+// 等待槽位栅栏的超时，正常情况下几帧前的上传早已完成
+const GLuint64 FENCE_TIMEOUT_NS = 50 * 1000 * 1000;
+// 孤立方式下的PBO个数，驱动每次孤立都另给存储，不需要和槽位一样多
+const int ORPHAN_BUFFER_COUNT = 3;
+
+PboRing::PboRing(int count) : count_(count), fences_(count, nullptr), states_(count)
+{
+    for (std::atomic<int> &state : states_)
+        state.store(SLOT_RETIRED, std::memory_order_relaxed);
+}
+
+PboRing::~PboRing()
+{
+    Destroy();
+}
+
+void PboRing::Destroy()
+{
+    for (size_t i = 0; i < fences_.size(); ++i)
+    {
+        if (fences_[i])
+        {
+            glDeleteSync(fences_[i]);
+            fences_[i] = nullptr;
+        }
+        states_[i].store(SLOT_RETIRED, std::memory_order_relaxed);
+    }
+    if (mapped_)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers_[0]);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        mapped_ = nullptr;
+    }
+    if (!buffers_.empty())
+    {
+        glDeleteBuffers((GLsizei)buffers_.size(), buffers_.data());
+        buffers_.clear();
+    }
+    slot_size_ = 0;
+    index_ = 0;
+}
+
+// 丢弃之前积累的GL错误，之后的glGetError只反映这里的调用
+static void ClearGlErrors()
+{
+    while (glGetError() != GL_NO_ERROR)
+    {
+    }
+}
+
+// 等待槽位的栅栏，timeout为0时只查询；栅栏已触发(或等待出错)时删除它并返回true
+static bool WaitFence(GLsync &fence, GLuint64 timeout)
+{
+    GLenum res = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    if (res == GL_TIMEOUT_EXPIRED && timeout == 0)
+        return false;
+    if (res == GL_TIMEOUT_EXPIRED || res == GL_WAIT_FAILED)
+        std::cerr << "等待PBO栅栏失败: " << res << std::endl;
+    glDeleteSync(fence);
+    fence = nullptr;
+    return true;
+}
+
+bool PboRing::Allocate(size_t slotSize)
+{
+    Destroy();
+    ClearGlErrors();
+    if (glExt.bufferStorage)
+    {
+        // 持久映射：一次映射终身有效，COHERENT保证写入无需显式flush即对GPU可见
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const GLsizeiptr total = (GLsizeiptr)(slotSize * count_);
+        buffers_.resize(1);
+        glGenBuffers(1, buffers_.data());
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers_[0]);
+        glExt.bufferStorage(GL_PIXEL_UNPACK_BUFFER, total, nullptr, flags);
+        mapped_ = (uint8_t *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total, flags);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (!mapped_)
+        {
+            std::cerr << "PBO持久映射失败，改用孤立方式" << std::endl;
+            glDeleteBuffers(1, buffers_.data());
+            buffers_.clear();
+            ClearGlErrors();
+        }
+    }
+    if (!mapped_)
+    {
+        buffers_.resize(ORPHAN_BUFFER_COUNT);
+        glGenBuffers(ORPHAN_BUFFER_COUNT, buffers_.data());
+        for (GLuint buffer : buffers_)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)slotSize, nullptr, GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    slot_size_ = slotSize;
+    GLenum err = glGetError();
+    if (err != GL_NO_ERROR)
+    {
+        std::cerr << "PBO分配失败: " << err << "，之后直接从客户端内存上传" << std::endl;
+        return false;
+    }
+    std::clog << "PBO ring: " << (mapped_ ? count_ : ORPHAN_BUFFER_COUNT) << " x " << slotSize << " bytes, "
+              << (mapped_ ? "persistent" : "orphaning") << std::endl;
+    // 映射地址和槽位容量都已写好，用release把槽位交给解码线程认领
+    if (mapped_)
+    {
+        for (std::atomic<int> &state : states_)
+            state.store(SLOT_FREE, std::memory_order_release);
+    }
+    return true;
+}
+
+int PboRing::Claim()
+{
+    for (int i = 0; i < count_; ++i)
+    {
+        int expected = SLOT_FREE;
+        if (states_[i].compare_exchange_strong(expected, SLOT_TAKEN, std::memory_order_acquire, std::memory_order_relaxed))
+            return i;
+    }
+    return -1;
+}
+
+void PboRing::Release(int slot)
+{
+    states_[slot].store(SLOT_FREE, std::memory_order_release);
+}
+
+PboSlot PboRing::Acquire(size_t size, uint8_t **data)
+{
+    int slot = Claim();
+    if (slot < 0)
+        return PboSlot();
+    // 认领成功之后，槽位容量和映射地址在归还之前不会再变
+    if (size > slot_size_)
+    {
+        size_t wanted = wanted_.load(std::memory_order_relaxed);
+        while (wanted < size && !wanted_.compare_exchange_weak(wanted, size, std::memory_order_relaxed))
+        {
+        }
+        Release(slot);
+        return PboSlot();
+    }
+    *data = mapped_ + slot_size_ * slot;
+    return PboSlot(this, slot);
+}
+
+void PboRing::Recycle()
+{
+    for (int i = 0; i < count_; ++i)
+    {
+        if (states_[i].load(std::memory_order_relaxed) == SLOT_SUBMITTED && WaitFence(fences_[i], 0))
+            states_[i].store(SLOT_FREE, std::memory_order_release);
+    }
+}
+
+bool PboRing::RetireAll()
+{
+    for (int i = 0; i < count_; ++i)
+    {
+        int state = states_[i].load(std::memory_order_relaxed);
+        if (state == SLOT_SUBMITTED)
+        {
+            WaitFence(fences_[i], FENCE_TIMEOUT_NS);
+            states_[i].store(SLOT_RETIRED, std::memory_order_relaxed);
+            continue;
+        }
+        int expected = SLOT_FREE;
+        if (state == SLOT_RETIRED ||
+            states_[i].compare_exchange_strong(expected, SLOT_RETIRED, std::memory_order_relaxed))
+            continue;
+        // 槽位还在解码线程或帧队列里，已经收回的槽位还给解码线程
+        if (mapped_)
+        {
+            for (int j = 0; j < i; ++j)
+                states_[j].store(SLOT_FREE, std::memory_order_release);
+        }
+        return false;
+    }
+    return true;
+}
+
+uint8_t *PboRing::Map(size_t size)
+{
+    // 分配失败过一次就一直走非PBO路径，不再每帧重试
+    if (failed_)
+        return nullptr;
+    Recycle();
+    size_t wanted = std::max(size, wanted_.load(std::memory_order_relaxed));
+    if (wanted > slot_size_)
+    {
+        // 只有没有槽位被占用时才能重新分配，否则这一帧直接从客户端内存上传
+        if (!RetireAll())
+            return nullptr;
+        if (!Allocate(wanted))
+        {
+            Destroy();
+            failed_ = true;
+            return nullptr;
+        }
+    }
+    if (mapped_)
+    {
+        int slot = Claim();
+        if (slot < 0)
+        {
+            // 没有空闲槽位时等一个已提交的槽位上传完
+            for (int i = 0; i < count_ && slot < 0; ++i)
+            {
+                if (states_[i].load(std::memory_order_relaxed) == SLOT_SUBMITTED)
+                {
+                    WaitFence(fences_[i], FENCE_TIMEOUT_NS);
+                    states_[i].store(SLOT_TAKEN, std::memory_order_relaxed);
+                    slot = i;
+                }
+            }
+            // 槽位都在帧队列里，直接从客户端内存上传
+            if (slot < 0)
+                return nullptr;
+        }
+        index_ = slot;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers_[0]);
+        return mapped_ + slot_size_ * index_;
+    }
+    // 孤立旧存储，驱动会另给一块内存，不必等待GPU读完上一次的数据
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers_[index_]);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)slot_size_, nullptr, GL_STREAM_DRAW);
+    uint8_t *ptr = (uint8_t *)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)size,
+                                               GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (!ptr)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return ptr;
+}
+
+size_t PboRing::Bind(PboSlot &slot)
+{
+    index_ = slot.index_;
+    slot.ring_ = nullptr;
+    slot.index_ = -1;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffers_[0]);
+    return slot_size_ * index_;
+}
+
+size_t PboRing::Unmap()
+{
+    if (mapped_)
+        return slot_size_ * index_;
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    return 0;
+}
+
+void PboRing::Submit()
+{
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    if (mapped_)
+    {
+        fences_[index_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        states_[index_].store(SLOT_SUBMITTED, std::memory_order_relaxed);
+        return;
+    }
+    index_ = (index_ + 1) % (int)buffers_.size();
+}
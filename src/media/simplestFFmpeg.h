@@ -3,6 +3,8 @@
 #define SIMPLEST_FFMPEG_H
 
 #include <iostream>
+#include <mutex>
+#include <condition_variable>
 #include <glad/glad.h>
 #ifdef __cplusplus
 extern "C"
@@ -30,10 +32,7 @@ public:
     };
     ~VedioFrame()
     {
-        std::cout << "delete frame begin" << std::endl;
         av_frame_free(&frame);
-        std::cout << "delete frame end~~" << std::endl;
-        
     };
     AVFrame *frame;
     double playTime;
@@ -53,10 +52,8 @@ public:
     VideoMessage(int64_t width, int64_t height, int status, VedioFrame *frame) : width(width), height(height), status(status), frame(frame){
     };
     virtual ~VideoMessage() {
-        std::cout << "delete frame" << std::endl;
         delete frame;
         frame = nullptr;
-        std::cout << "delete frame end" << std::endl;
     };
     int64_t width;
     int64_t height;
@@ -84,7 +81,6 @@ public:
         notFull.wait(lock, [this]()
                      { return (writeIndex + 1) % size != readIndex; });
         buffer[writeIndex] = msg;
-        std::cout << "push index:" << writeIndex << std::endl;
         writeIndex = (writeIndex + 1) % size;
         notEmpty.notify_one();
         
@@ -96,7 +92,6 @@ public:
         notEmpty.wait(lock, [this]()
                       { return writeIndex != readIndex; });
         VideoMessage *msg = buffer[readIndex];
-         std::cout << "pop index:" << readIndex << std::endl;
         readIndex = (readIndex + 1) % size;
         notFull.notify_one();
         return msg;
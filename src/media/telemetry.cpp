@@ -0,0 +1,131 @@
+#include "include/telemetry.h"
+
+int LatencyHistogram::BucketIndex(int64_t value)
+{
+    if (value < SUB_BUCKETS)
+        return value < 0 ? 0 : (int)value;
+    int exponent = 63 - __builtin_clzll((unsigned long long)value);
+    if (exponent >= MAX_EXPONENT)
+        return BUCKET_COUNT - 1;
+    // 取最高位之后的SUB_BUCKET_BITS位作为区间内的格号
+    int sub = (int)(value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+int64_t LatencyHistogram::BucketUpperBound(int index)
+{
+    if (index < SUB_BUCKETS)
+        return index;
+    int exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    int sub = index % SUB_BUCKETS;
+    int shift = exponent - SUB_BUCKET_BITS;
+    return ((int64_t)(SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(int64_t value)
+{
+    if (value < 0)
+        value = 0;
+    buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+    // 单写者，最值不必用CAS
+    if (value < min_.load(std::memory_order_relaxed))
+        min_.store(value, std::memory_order_relaxed);
+    if (value > max_.load(std::memory_order_relaxed))
+        max_.store(value, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_release);
+}
+
+HistogramSummary LatencyHistogram::Summary() const
+{
+    HistogramSummary summary;
+    // 与写线程并发时各格之和可能与count_略有出入，百分位以实际读到的格为准
+    uint64_t counts[BUCKET_COUNT];
+    uint64_t total = 0;
+    for (int i = 0; i < BUCKET_COUNT; ++i)
+    {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0)
+        return summary;
+    summary.count = total;
+    summary.min = min_.load(std::memory_order_relaxed);
+    summary.max = max_.load(std::memory_order_relaxed);
+    summary.mean = (double)sum_.load(std::memory_order_relaxed) / total;
+
+    const double quantiles[] = {0.5, 0.9, 0.99};
+    int64_t *targets[] = {&summary.p50, &summary.p90, &summary.p99};
+    uint64_t seen = 0;
+    int q = 0;
+    for (int i = 0; i < BUCKET_COUNT && q < 3; ++i)
+    {
+        seen += counts[i];
+        while (q < 3 && seen >= quantiles[q] * total)
+        {
+            // 格的上界可能超出实际出现过的最大值
+            int64_t bound = BucketUpperBound(i);
+            *targets[q++] = bound < summary.max ? bound : summary.max;
+        }
+    }
+    return summary;
+}
+
+// 两个时间戳都有效时记录它们的差
+static void RecordSpan(LatencyHistogram &histogram, int64_t from, int64_t to)
+{
+    if (from > 0 && to > 0)
+        histogram.Record(to - from);
+}
+
+void FrameTelemetry::Record(const FrameTiming &timing)
+{
+    RecordSpan(decode_, timing.demux, timing.decoded);
+    RecordSpan(convert_, timing.decoded, timing.converted);
+    RecordSpan(queue_, timing.converted, timing.popped);
+    RecordSpan(upload_, timing.popped, timing.uploaded);
+    RecordSpan(present_, timing.uploaded, timing.presented);
+    RecordSpan(total_, timing.demux, timing.presented);
+    frames_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameTelemetry::Fill(TelemetrySnapshot &snapshot) const
+{
+    snapshot.frames_presented = frames_.load(std::memory_order_relaxed);
+    snapshot.decode = decode_.Summary();
+    snapshot.convert = convert_.Summary();
+    snapshot.queue = queue_.Summary();
+    snapshot.upload = upload_.Summary();
+    snapshot.present = present_.Summary();
+    snapshot.total = total_.Summary();
+}
+
+static void writeSpan(std::ostream &out, const char *name, const HistogramSummary &summary)
+{
+    if (summary.count == 0)
+        return;
+    out << ' ' << name << ' ' << summary.p50 / 1000.0 << '/' << summary.p99 / 1000.0;
+}
+
+std::ostream &operator<<(std::ostream &out, const TelemetrySnapshot &snapshot)
+{
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out.setf(std::ios::fixed);
+    out.precision(1);
+    out << "frames " << snapshot.frames_presented
+        << ", drops late " << snapshot.frame_drops_late << " early " << snapshot.frame_drops_early
+        << ", underruns " << snapshot.audio_underruns
+        << ", queued vpkt " << snapshot.video_packets_queued << " apkt " << snapshot.audio_packets_queued
+        << " frames " << snapshot.video_frames_queued << " pcm " << snapshot.pcm_bytes_queued << "B"
+        << ", p50/p99 ms:";
+    writeSpan(out, "decode", snapshot.decode);
+    writeSpan(out, "convert", snapshot.convert);
+    writeSpan(out, "queue", snapshot.queue);
+    writeSpan(out, "upload", snapshot.upload);
+    writeSpan(out, "present", snapshot.present);
+    writeSpan(out, "total", snapshot.total);
+    out.flags(flags);
+    out.precision(precision);
+    return out;
+}
@@ -0,0 +1,49 @@
+#include "include/textureset.h"
+
+#include <common/gl_ext.h>
+#include <iostream>
+
+TextureSet::~TextureSet()
+{
+    Release();
+}
+
+void TextureSet::Release()
+{
+    if (format_)
+    {
+        glDeleteTextures(format_->planeCount, textures_);
+        format_ = nullptr;
+    }
+}
+
+bool TextureSet::Ensure(const VideoFormat *format, int width, int height)
+{
+    if (format == format_ && width == width_ && height == height_)
+        return false;
+    Release();
+    glGenTextures(format->planeCount, textures_);
+    for (int i = 0; i < format->planeCount; ++i)
+    {
+        const PlaneLayout &plane = format->planes[i];
+        glBindTexture(GL_TEXTURE_2D, textures_[i]);
+        // 设置环绕方式
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);     // x轴
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);     // y轴
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // 缩小
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR); // 放大
+        // 只有一级，没有mipmap
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        if (glExt.texStorage2D)
+            glExt.texStorage2D(GL_TEXTURE_2D, 1, plane.internalFormat, plane.Width(width), plane.Height(height));
+        else
+            glTexImage2D(GL_TEXTURE_2D, 0, plane.internalFormat, plane.Width(width), plane.Height(height),
+                         0, plane.format, plane.type, nullptr);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    format_ = format;
+    width_ = width;
+    height_ = height;
+    std::clog << "texture set: " << width << "x" << height << ", planes: " << format->planeCount << std::endl;
+    return true;
+}
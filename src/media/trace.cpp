@@ -0,0 +1,210 @@
+#include "include/trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+extern "C"
+{
+#include <libavutil/time.h>
+}
+
+// 每块的事件数、Open时预先分配的块数和线程缓冲数，合计约100万个事件
+const size_t TRACE_CHUNK_EVENTS = 16384;
+const size_t TRACE_POOL_CHUNKS = 64;
+const size_t TRACE_MAX_THREADS = 16;
+
+struct TraceEvent
+{
+    const char *name;
+    // 'X' 完整区间，'i' 瞬时事件，'C' 计数器
+    char phase;
+    int64_t ts;
+    int64_t dur;
+    double value;
+};
+
+namespace
+{
+    // 线程缓存的当前缓冲，会话号不一致说明是上一次记录留下的
+    struct ThreadCache
+    {
+        uint64_t session = 0;
+        TraceBuffer *buffer = nullptr;
+    };
+    thread_local ThreadCache threadCache;
+
+    std::atomic<uint64_t> nextSession{1};
+}
+
+/// @brief 单个线程独占的事件缓冲，只有所属线程追加，Close时才由别的线程读取
+class TraceBuffer
+{
+public:
+    explicit TraceBuffer(int tid) : tid(tid)
+    {
+        // 认领事件块时只追加指针，不能在记录线程上扩容
+        chunks.reserve(TRACE_POOL_CHUNKS);
+    }
+
+    const int tid;
+    const char *name = nullptr;
+    std::vector<TraceEvent *> chunks;
+    size_t size = 0;
+    uint64_t dropped = 0;
+};
+
+TraceRecorder::TraceRecorder()
+{
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    Close();
+}
+
+bool TraceRecorder::Open(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    path_ = path;
+    buffers_.clear();
+    chunks_.clear();
+    for (size_t i = 0; i < TRACE_MAX_THREADS; ++i)
+        buffers_.emplace_back(new TraceBuffer((int)i + 1));
+    // 值初始化顺带把内存页都碰一遍，记录线程写入时不会再触发缺页
+    for (size_t i = 0; i < TRACE_POOL_CHUNKS; ++i)
+        chunks_.emplace_back(new TraceEvent[TRACE_CHUNK_EVENTS]());
+    nextBuffer_.store(0, std::memory_order_relaxed);
+    nextChunk_.store(0, std::memory_order_relaxed);
+    dropped_.store(0, std::memory_order_relaxed);
+    session_ = nextSession.fetch_add(1);
+    start_ = Now();
+    enabled_.store(true, std::memory_order_release);
+    return true;
+}
+
+int64_t TraceRecorder::Now()
+{
+    return av_gettime_relative();
+}
+
+TraceBuffer *TraceRecorder::ThreadBuffer()
+{
+    ThreadCache &cache = threadCache;
+    if (cache.session != session_)
+    {
+        size_t index = nextBuffer_.fetch_add(1, std::memory_order_relaxed);
+        cache.buffer = index < buffers_.size() ? buffers_[index].get() : nullptr;
+        cache.session = session_;
+    }
+    return cache.buffer;
+}
+
+void TraceRecorder::Record(const TraceEvent &event)
+{
+    TraceBuffer *buffer = ThreadBuffer();
+    if (!buffer)
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    size_t offset = buffer->size % TRACE_CHUNK_EVENTS;
+    if (offset == 0 && buffer->size / TRACE_CHUNK_EVENTS == buffer->chunks.size())
+    {
+        size_t index = nextChunk_.fetch_add(1, std::memory_order_relaxed);
+        if (index >= chunks_.size())
+        {
+            ++buffer->dropped;
+            return;
+        }
+        buffer->chunks.push_back(chunks_[index].get());
+    }
+    buffer->chunks[buffer->size / TRACE_CHUNK_EVENTS][offset] = event;
+    ++buffer->size;
+}
+
+void TraceRecorder::NameThread(const char *name)
+{
+    if (!Enabled())
+        return;
+    TraceBuffer *buffer = ThreadBuffer();
+    if (buffer)
+        buffer->name = name;
+}
+
+void TraceRecorder::Complete(const char *name, int64_t start, int64_t end)
+{
+    if (Enabled())
+        Record(TraceEvent{name, 'X', start - start_, end - start, 0});
+}
+
+void TraceRecorder::Instant(const char *name)
+{
+    if (Enabled())
+        Record(TraceEvent{name, 'i', Now() - start_, 0, 0});
+}
+
+void TraceRecorder::Counter(const char *name, double value)
+{
+    // NAN和无穷大写进JSON是非法的，直接跳过
+    if (Enabled() && std::isfinite(value))
+        Record(TraceEvent{name, 'C', Now() - start_, 0, value});
+}
+
+bool TraceRecorder::Close()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (!Enabled())
+        return false;
+    enabled_.store(false, std::memory_order_release);
+    FILE *file = fopen(path_.c_str(), "w");
+    if (!file)
+    {
+        std::cerr << "无法写入trace文件: " << path_ << std::endl;
+        buffers_.clear();
+        chunks_.clear();
+        return false;
+    }
+    size_t total = 0;
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    size_t used = std::min(nextBuffer_.load(std::memory_order_relaxed), buffers_.size());
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"DDYPlayer\"}}");
+    for (size_t b = 0; b < used; ++b)
+    {
+        const TraceBuffer *buffer = buffers_[b].get();
+        if (buffer->name)
+            fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                    buffer->tid, buffer->name);
+        for (size_t i = 0; i < buffer->size; ++i)
+        {
+            const TraceEvent &event = buffer->chunks[i / TRACE_CHUNK_EVENTS][i % TRACE_CHUNK_EVENTS];
+            switch (event.phase)
+            {
+            case 'X':
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld}",
+                        event.name, buffer->tid, (long long)event.ts, (long long)event.dur);
+                break;
+            case 'i':
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%lld}",
+                        event.name, buffer->tid, (long long)event.ts);
+                break;
+            default:
+                fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"args\":{\"value\":%g}}",
+                        event.name, buffer->tid, (long long)event.ts, event.value);
+                break;
+            }
+        }
+        total += buffer->size;
+        dropped += buffer->dropped;
+    }
+    fprintf(file, "\n]}\n");
+    bool ok = ferror(file) == 0;
+    ok = fclose(file) == 0 && ok;
+    std::clog << "trace: " << total << " events written to " << path_;
+    if (dropped > 0)
+        std::clog << ", " << dropped << " dropped";
+    std::clog << std::endl;
+    buffers_.clear();
+    chunks_.clear();
+    return ok;
+}
@@ -0,0 +1,69 @@
+#include "include/videoformat.h"
+
+#include <cstring>
+
+// 三平面YUV，每个平面一张单通道纹理
+#define PLANAR_420_8(fmt)                                                    \
+    {                                                                        \
+        fmt, "shaders/media/media.frag", 1.0f, 3,                            \
+        {                                                                    \
+            {"textureY", 0, 0, 1, GL_R8, GL_RED, GL_UNSIGNED_BYTE},          \
+            {"textureU", 1, 1, 1, GL_R8, GL_RED, GL_UNSIGNED_BYTE},          \
+            {"textureV", 1, 1, 1, GL_R8, GL_RED, GL_UNSIGNED_BYTE},          \
+        }                                                                    \
+    }
+
+// 高位深三平面YUV，样本低位对齐存放在16位中，用GL_R16上传，不做位深转换
+#define PLANAR_420_16(fmt, bits)                                             \
+    {                                                                        \
+        fmt, "shaders/media/media.frag", 65535.0f / ((1 << (bits)) - 1), 3,  \
+        {                                                                    \
+            {"textureY", 0, 0, 2, GL_R16, GL_RED, GL_UNSIGNED_SHORT},        \
+            {"textureU", 1, 1, 2, GL_R16, GL_RED, GL_UNSIGNED_SHORT},        \
+            {"textureV", 1, 1, 2, GL_R16, GL_RED, GL_UNSIGNED_SHORT},        \
+        }                                                                    \
+    }
+
+static const VideoFormat VIDEO_FORMATS[] = {
+    PLANAR_420_8(AV_PIX_FMT_YUV420P),
+    // 与YUV420P只是色彩范围不同，平面布局一致
+    PLANAR_420_8(AV_PIX_FMT_YUVJ420P),
+    // 亮度一个平面，色度UV交错在第二个平面，用双通道纹理一次采到两个分量
+    {AV_PIX_FMT_NV12, "shaders/media/media_nv12.frag", 1.0f, 2,
+     {
+         {"textureY", 0, 0, 1, GL_R8, GL_RED, GL_UNSIGNED_BYTE},
+         {"textureUV", 1, 1, 2, GL_RG8, GL_RG, GL_UNSIGNED_BYTE},
+     }},
+    PLANAR_420_16(AV_PIX_FMT_YUV420P10LE, 10),
+    PLANAR_420_16(AV_PIX_FMT_YUV420P12LE, 12),
+    // NV12的10位版本，样本高位对齐，低6位为0，采样值只需把1023<<6拉伸到满量程
+    {AV_PIX_FMT_P010LE, "shaders/media/media_nv12.frag", 65535.0f / (1023 << 6), 2,
+     {
+         {"textureY", 0, 0, 2, GL_R16, GL_RED, GL_UNSIGNED_SHORT},
+         {"textureUV", 1, 1, 4, GL_RG16, GL_RG, GL_UNSIGNED_SHORT},
+     }},
+};
+
+const VideoFormat *FindVideoFormat(AVPixelFormat pixFmt)
+{
+    for (const VideoFormat &format : VIDEO_FORMATS)
+    {
+        if (format.pixFmt == pixFmt)
+            return &format;
+    }
+    return nullptr;
+}
+
+std::vector<const char *> VideoFragmentShaders()
+{
+    std::vector<const char *> shaders;
+    for (const VideoFormat &format : VIDEO_FORMATS)
+    {
+        bool found = false;
+        for (const char *shader : shaders)
+            found = found || strcmp(shader, format.fragmentShader) == 0;
+        if (!found)
+            shaders.push_back(format.fragmentShader);
+    }
+    return shaders;
+}
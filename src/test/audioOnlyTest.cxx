@@ -0,0 +1,65 @@
+// 纯音频输入按节奏播放时要一直播到文件末尾，不能因为没有视频帧就提前返回
+// 用法: AudioOnlyTest [文件]，忽略文件中的视频流，用按节奏拉取的Null输出播放，播完返回0
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include "media/include/player.h"
+extern "C"
+{
+#include <libavformat/avformat.h>
+}
+
+const char *DEFAULT_FILE = "media/Titanic.ts";
+// 允许的提前量(秒)，覆盖启动和设备缓冲的误差
+const double TOLERANCE = 1.0;
+
+/// @brief 文件中最佳音频流的时长(秒)，取不到时返回负数
+static double audioDuration(const std::string &file)
+{
+    AVFormatContext *fmt_ctx = nullptr;
+    if (avformat_open_input(&fmt_ctx, file.c_str(), nullptr, nullptr) != 0)
+        return -1;
+    double duration = -1;
+    if (avformat_find_stream_info(fmt_ctx, nullptr) >= 0)
+    {
+        int index = av_find_best_stream(fmt_ctx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+        if (index >= 0 && fmt_ctx->streams[index]->duration != AV_NOPTS_VALUE)
+            duration = fmt_ctx->streams[index]->duration * av_q2d(fmt_ctx->streams[index]->time_base);
+        else if (index >= 0 && fmt_ctx->duration != AV_NOPTS_VALUE)
+            duration = (double)fmt_ctx->duration / AV_TIME_BASE;
+    }
+    avformat_close_input(&fmt_ctx);
+    return duration;
+}
+
+int main(int argc, char **argv)
+{
+    std::string file = argc > 1 ? argv[1] : DEFAULT_FILE;
+    double duration = audioDuration(file);
+    if (duration <= 0)
+    {
+        std::cerr << "无法获取音频时长: " << file << std::endl;
+        return 1;
+    }
+
+    PlayerOptions options;
+    options.skip_video = true;
+    options.skip_render = true;
+    options.audio_output = AudioOutput::Null;
+    options.audio_paced = true;
+    options.telemetry_interval = 0;
+    MediaPlayer player(file, 800, 600, options);
+    if (!player.IsReady())
+    {
+        std::cerr << "初始化失败: " << file << std::endl;
+        return 1;
+    }
+    player.Play();
+    player.Stop();
+
+    PlayerStats stats = player.Stats();
+    bool ok = stats.audio_samples > 0 && stats.play_time >= duration - TOLERANCE;
+    printf("audio only: played %.2fs of %.2fs, %llu samples: %s\n", stats.play_time, duration,
+           (unsigned long long)stats.audio_samples, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+// 生产者和消费者之外的第三个线程读取size()(例如遥测和trace采样队列积压)，结果不能超出容量
+// 用法: QueueSizeTest，全部通过返回0
+// 三个线程都不让出CPU，单核机器上靠时间片抢占把读取size()的线程停在两次原子读之间，同样能暴露问题
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <toolkit/spscq.h>
+#include <toolkit/pcmring.h>
+
+// 每项测试的运行时长
+const std::chrono::milliseconds DURATION(1000);
+// 至少要绕环这么多圈才算覆盖了读写位置的回绕
+const uint64_t MIN_LAPS = 16;
+
+struct Observation
+{
+    size_t maxSize = 0;
+    // 消费者取出的元素个数(PcmRing为字节数)
+    uint64_t consumed = 0;
+    // 消费者发现的顺序或内容错误个数
+    uint64_t corrupt = 0;
+};
+
+/// @brief 生产者连续写到队列满，消费者等队列满后一口气取出一整个容量，两者都不让出CPU，
+/// 队列在空和满之间反复摆动并不断绕环；本线程同时不停读取size()，记录观察到的最大值
+/// @param produce 写入一批，返回是否写入了数据
+/// @param consume 取出最多一个容量的数据，返回取出的个数
+template <typename ProduceFn, typename ConsumeFn, typename SizeFn>
+static Observation observe(size_t capacity, ProduceFn produce, ConsumeFn consume, SizeFn size)
+{
+    Observation result;
+    std::atomic<bool> stop{false};
+    std::thread producer([&]()
+                         {
+        while (!stop.load(std::memory_order_relaxed))
+            produce(); });
+    std::thread consumer([&]()
+                         {
+        while (!stop.load(std::memory_order_relaxed))
+        {
+            if (size() < capacity)
+                continue;
+            result.consumed += consume();
+        } });
+    auto deadline = std::chrono::steady_clock::now() + DURATION;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        for (int i = 0; i < 1024; ++i)
+        {
+            size_t n = size();
+            if (n > result.maxSize)
+                result.maxSize = n;
+        }
+    }
+    stop.store(true, std::memory_order_relaxed);
+    producer.join();
+    consumer.join();
+    return result;
+}
+
+/// @brief 检查观察结果：size()不超过容量，队列确实被写满过，数据绕环足够多圈且顺序、内容无误
+static bool report(const char *name, const Observation &obs, size_t capacity)
+{
+    // 超出容量说明size()读错；达不到容量说明队列没被写满过，这次运行没有覆盖满队列的情况
+    bool ok = obs.maxSize == capacity && obs.consumed >= MIN_LAPS * capacity && obs.corrupt == 0;
+    printf("%s max %zu, capacity %zu, laps %llu, corrupt %llu: %s\n", name, obs.maxSize, capacity,
+           (unsigned long long)(obs.consumed / capacity), (unsigned long long)obs.corrupt, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static bool testSpscQueue()
+{
+    SpscQueue<uint64_t> queue(64);
+    uint64_t next = 0;
+    uint64_t expected = 0;
+    uint64_t corrupt = 0;
+    Observation obs = observe(
+        queue.capacity(),
+        [&]()
+        {
+            bool pushed = false;
+            while (queue.try_push(next))
+            {
+                ++next;
+                pushed = true;
+            }
+            return pushed;
+        },
+        [&]()
+        {
+            uint64_t n = 0;
+            uint64_t item;
+            while (n < queue.capacity() && queue.try_pop(item))
+            {
+                if (item != expected)
+                    ++corrupt;
+                expected = item + 1;
+                ++n;
+            }
+            return n;
+        },
+        [&]()
+        { return queue.size(); });
+    obs.corrupt = corrupt;
+    return report("SpscQueue::size ", obs, queue.capacity());
+}
+
+static bool testPcmRing()
+{
+    // 容量不是写入块大小的整数倍，写入和读取的区域会跨过缓冲末尾
+    const size_t chunk = 96;
+    PcmRing ring(4000);
+    uint8_t buf[4000];
+    uint8_t written = 0;
+    uint8_t expected = 0;
+    uint64_t corrupt = 0;
+    Observation obs = observe(
+        ring.capacity(),
+        [&]()
+        {
+            uint8_t *spans[2];
+            size_t lens[2];
+            size_t free = ring.reserve(&spans[0], &lens[0], &spans[1], &lens[1]);
+            size_t n = free < chunk ? free : chunk;
+            for (size_t i = 0; i < n; ++i)
+                (i < lens[0] ? spans[0][i] : spans[1][i - lens[0]]) = written++;
+            ring.commit(n);
+            return n > 0;
+        },
+        [&]()
+        {
+            size_t n = ring.read(buf, sizeof(buf));
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (buf[i] != expected)
+                    ++corrupt;
+                expected = buf[i] + 1;
+            }
+            return (uint64_t)n;
+        },
+        [&]()
+        { return ring.size(); });
+    obs.corrupt = corrupt;
+    return report("PcmRing::size   ", obs, ring.capacity());
+}
+
+int main()
+{
+    bool ok = testSpscQueue();
+    ok = testPcmRing() && ok;
+    return ok ? 0 : 1;
+}
@@ -155,13 +155,14 @@ void Transform2D::start()
     baseMat = glm::rotate<float>(baseMat, glm::radians(-90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
     transform = &baseMat;
     transformInputAsync();
+    // 循环外取好uniform位置，每帧直接glUniform
+    GLint transformLoc = shader->uniformLocation("transform");
     while (!glfwWindowShouldClose(window))
     {
         glClearColor(1.0f, 1.0f, 1.0f, 1.0f); // 设置清屏颜色
         glClear(GL_COLOR_BUFFER_BIT);         // 清屏
         shader->use();
-        std::string name = "transform";
-        shader->setMat4(name, *transform);
+        shader->setMat4(transformLoc, *transform);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, texture1);
         glBindVertexArray(VAO);